@@ -0,0 +1,76 @@
+/*	
+ *	@author		abradbury
+ *	
+ *	Arena.c is a bump pointer allocator for work that has a clear start and 
+ *	end, such as decoding a received message. Allocations are taken from the 
+ *	front of a fixed block of memory and are never freed one by one. Instead 
+ *	a mark is taken before the work starts and the arena is reset to it when 
+ *	the work is done, which releases everything allocated since in one step. 
+ *	Marks nest, so a piece of work can take its own mark inside another.
+ *	
+ *	decodeArena is used for the received message and the shared working 
+ *	memory (see workmem.c) while it is shown or played. Compiled ringtones 
+ *	are kept in the tone cache instead (see tone.c), so the arena is only 
+ *	DECODE_ARENA bytes and the rest of the MSYS heap is left for everything 
+ *	else. A received message of more than DECODE_MAX bytes is reassembled in 
+ *	a block from the MSYS heap instead (see init_text() in text.c).
+ */
+
+#include "arena.h"
+
+ARENA_Type		decodeArena;		// The arena used to decode received messages
+
+/*	
+ *	arenaInit() sets up an arena over a block of memory.
+ *	
+ *	@param	arena		The arena to set up
+ *	@param	mem			The memory to hand out, 0 gives an arena that is always full
+ *	@param	size		The size of the memory
+ */
+void arenaInit(ARENA_Type *arena, void *mem, uint32_t size)
+{
+	arena->base = (uint8_t*)mem;
+	arena->size = mem ? size : 0;
+	arena->used = 0;
+}
+
+/*	
+ *	arenaAlloc() hands out the next size bytes of the arena, aligned to 4 bytes 
+ *	so any type can be stored. The memory is not cleared.
+ *	
+ *	@param	arena		The arena to allocate from
+ *	@param	size		The number of bytes needed
+ *	@return				The memory, or 0 if the arena does not have enough left
+ */
+void* arenaAlloc(ARENA_Type *arena, uint32_t size)
+{
+	uint32_t start = (arena->used + 3) & ~3;
+	
+	if(size > arena->size || start > arena->size - size) return 0;
+	
+	arena->used = start + size;
+	return arena->base + start;
+}
+
+/*	
+ *	arenaMark() returns the current position in the arena, to be given to 
+ *	arenaReset() when the work is done.
+ *	
+ *	@param	arena		The arena
+ *	@return				The mark
+ */
+uint32_t arenaMark(ARENA_Type *arena)
+{
+	return arena->used;
+}
+
+/*	
+ *	arenaReset() releases everything allocated since the mark was taken.
+ *	
+ *	@param	arena		The arena
+ *	@param	mark		A mark from arenaMark()
+ */
+void arenaReset(ARENA_Type *arena, uint32_t mark)
+{
+	if(mark < arena->used) arena->used = mark;
+}
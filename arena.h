@@ -0,0 +1,25 @@
+/*	
+ *	@author		abradbury
+ */
+
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include "stdint.h"
+
+#define DECODE_ARENA	0x1000		// Bytes of the MSYS heap used for decoding messages
+#define DECODE_MAX		(DECODE_ARENA-36)	// Longest message kept in the arena, leaving room for its '\0' and the LCD window
+
+typedef struct {
+	uint8_t		*base;				// The memory handed out
+	uint32_t	size;				// The size of the memory
+	uint32_t	used;				// The bytes handed out so far
+} ARENA_Type;
+
+extern ARENA_Type	decodeArena;
+
+void arenaInit(ARENA_Type *arena, void *mem, uint32_t size);
+void* arenaAlloc(ARENA_Type *arena, uint32_t size);
+uint32_t arenaMark(ARENA_Type *arena);
+void arenaReset(ARENA_Type *arena, uint32_t mark);
+#endif
@@ -0,0 +1,458 @@
+/*
+ *	@author		abradbury
+ *
+ *	audio_bench.c renders the phone's sounds on the host (Linux), running the
+ *	firmware's own music.c, morse.c, seq.c, synth.c, tone.c and rtttl.c, so
+ *	ringtones can be listened to and checked without a board. The headers
+ *	in bench/sim stand in for the NXP and CMSIS ones, and this file for the
+ *	hardware:
+ *
+ *	- Timer0 counts a millisecond every SYNTH_RATE/1000 samples, sets the
+ *	  interrupt flag of a match register when the count reaches it, and
+ *	  calls TIMER0_IRQHandler() (seq.c) as the NVIC would,
+ *	- the DAC takes a sample from the DMA buffers each sample time, and the
+ *	  end of each buffer calls synthRender() on it, as DMA_IRQHandler() in
+ *	  dac.c does; dacStart() and dacStop() are as in dac.c, and the DAC
+ *	  holds its last value while stopped,
+ *	- __WFI(), which play() sleeps in, moves the time on a millisecond.
+ *
+ *	Each ringtone of the menu (ringtones.c) is played by rtttlDecode() to the
+ *	end of its last release, then one with the chime of notify() over it,
+ *	then "SOS" in morse code. For each it checks:
+ *
+ *	- timing: the sound lasts the sum of the notes' lengths plus SEQ_TAIL,
+ *	  to the millisecond,
+ *	- pitch: the frequency of each note, from the rising zero crossings in
+ *	  the part of the note clear of its attack and of the DMA latency, is
+ *	  within PITCH_ERR of the equal tempered note, and pauses are silent,
+ *	- morse: the beeps read back as the code sent, at the morse note,
+ *
+ *	and prints how many times faster than real time it was rendered. With a
+ *	directory as its argument it also writes each sound there as a 16 bit
+ *	mono WAV file at SYNTH_RATE ('make wav' writes them to bench/wav).
+ *
+ *	Build and run with 'make bench' from the top directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "lpc17xx_timer.h"
+#include "debug_frmwrk.h"
+#include "memmap.h"
+#include "mysys.h"
+#include "arena.h"
+#include "tone.h"
+#include "seq.h"
+#include "synth.h"
+#include "music.h"
+#include "morse.h"
+#include "ringtones.h"
+
+#define MS_SAMPLES		(SYNTH_RATE/1000)	// Samples per timer tick
+#define PITCH_ERR		0.5					// Largest pitch error allowed, in percent
+#define MIN_CYCLES		4					// Fewest cycles a note is measured over
+#define CHIME_AT		500					// ms into the ringtone notify() is called
+#define MORSE_WPM		25					// As serial.c sets up
+#define MORSE_SENT		"SOS"
+#define MORSE_CODE		"...---..."
+#define MAX_MS			120000				// Longest sound, in case one never ends
+
+void TIMER0_IRQHandler();
+
+LPC_TIM_TypeDef		simTimer0;				// Timer0's registers
+static int			irqOn = 0;				// 1 if the Timer0 interrupt is enabled
+static int			dacOn = 0;				// 1 while the DMA feeds the DAC
+static uint32_t		dacBuffer[2*DAC_BLOCK];	// The two DMA buffers
+static int			dacPos = 0;				// The next sample the DMA sends
+static uint32_t		dacValue = SYNTH_MID << 6;	// The DAC register
+
+static int16_t		*rec;					// The sound rendered, as 16 bit samples
+static int			recLen = 0, recSize = 0;
+static double		simSeconds = 0, simWall = 0;
+
+static uint8_t		heap[HEAP_SIZE];		// The MSYS heap
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/*
+ *	The hardware. The timer and DMA setup is not needed, only what the
+ *	interrupts see.
+ */
+void TIM_Init(LPC_TIM_TypeDef *timer, uint8_t mode, void *config)
+{
+	memset(timer, 0, sizeof(*timer));
+}
+
+void TIM_ConfigMatch(LPC_TIM_TypeDef *timer, TIM_MATCHCFG_Type *match)
+{
+	timer->MCR |= match->IntOnMatch << (3*match->MatchChannel);
+	(&timer->MR0)[match->MatchChannel] = match->MatchValue;
+}
+
+void TIM_Cmd(LPC_TIM_TypeDef *timer, FunctionalState state)
+{
+	timer->TCR = state;
+}
+
+void TIM_ResetCounter(LPC_TIM_TypeDef *timer)
+{
+	timer->TC = 0;
+	timer->PC = 0;
+}
+
+FlagStatus TIM_GetIntStatus(LPC_TIM_TypeDef *timer, TIM_INT_TYPE flag)
+{
+	return (timer->IR >> flag) & 1 ? SET : RESET;
+}
+
+void TIM_ClearIntPending(LPC_TIM_TypeDef *timer, TIM_INT_TYPE flag)
+{
+	timer->IR &= ~(1u << flag);
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq)
+{
+	if(irq != TIMER0_IRQn) return;
+	irqOn = 1;
+	if(simTimer0.IR) TIMER0_IRQHandler();
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq)
+{
+	if(irq == TIMER0_IRQn) irqOn = 0;
+}
+
+void dacStart()
+{
+	synthRender(dacBuffer, 2*DAC_BLOCK);
+	dacPos = 0;
+	dacOn = 1;
+}
+
+void dacStop()
+{
+	dacOn = 0;
+}
+
+/*
+ *	simStep() moves the time on a millisecond: the DAC takes its samples,
+ *	then Timer0 counts.
+ */
+static void simStep(void)
+{
+	int i, v;
+
+	for(i=0; i<MS_SAMPLES; i++)
+	{
+		if(dacOn)
+		{
+			dacValue = dacBuffer[dacPos++];
+			if(dacPos == DAC_BLOCK) synthRender(dacBuffer, DAC_BLOCK);
+			else if(dacPos == 2*DAC_BLOCK)
+			{
+				synthRender(&dacBuffer[DAC_BLOCK], DAC_BLOCK);
+				dacPos = 0;
+			}
+		}
+		if(recLen == recSize)
+		{
+			recSize = recSize ? 2*recSize : SYNTH_RATE;
+			rec = realloc(rec, recSize*sizeof(*rec));
+		}
+		rec[recLen++] = (int)(((dacValue >> 6) & 0x3FF) - SYNTH_MID) * 64;
+	}
+
+	if(simTimer0.TCR & 1)
+	{
+		simTimer0.TC++;
+		for(v=0; v<4; v++)
+		{
+			if(((simTimer0.MCR >> 3*v) & 1) && (&simTimer0.MR0)[v] == simTimer0.TC) simTimer0.IR |= 1u << v;
+		}
+	}
+	if(irqOn && simTimer0.IR) TIMER0_IRQHandler();
+}
+
+void __WFI(void)
+{
+	simStep();
+}
+
+/*
+ *	The rest of the board, which the sound does not need.
+ */
+void UARTPutChar(LPC_UART_TypeDef *uart, uint8_t ch) {}
+void UARTPuts(LPC_UART_TypeDef *uart, const void *str) {}
+void UARTPutDec(LPC_UART_TypeDef *uart, uint8_t num) {}
+void UARTPutDec16(LPC_UART_TypeDef *uart, uint16_t num) {}
+int write_usb_serial_blocking(char *buf, int length) { return length; }
+void clear_screen() {}
+void put_mult_char_lcd(char input[], char offset, int line) {}
+
+/*
+ *	finish() runs the time on until the DAC stops, then adds the sound to
+ *	the totals for the real time multiple.
+ *
+ *	@param	start		When the sound was started, from now()
+ *	@return				The length of the sound in ms
+ */
+static int finish(double start)
+{
+	while(dacOn && recLen < MAX_MS*MS_SAMPLES) simStep();
+	simWall += now() - start;
+	simSeconds += (double)recLen / SYNTH_RATE;
+	return recLen / MS_SAMPLES;
+}
+
+/*
+ *	pitch() measures the frequency of the sound between two samples, from
+ *	the first to the last rising zero crossing.
+ *
+ *	@return				The frequency in Hz, 0 if there are under MIN_CYCLES
+ */
+static double pitch(int from, int to)
+{
+	double x, first = 0, last = 0;
+	int i, n = 0;
+
+	for(i=from+1; i<to && i<recLen; i++)
+	{
+		if(rec[i-1] < 0 && rec[i] >= 0)
+		{
+			x = i-1 + (double)-rec[i-1] / (rec[i] - rec[i-1]);
+			if(n == 0) first = x;
+			last = x;
+			n++;
+		}
+	}
+	if(n <= MIN_CYCLES) return 0;
+	return (n-1) * (double)SYNTH_RATE / (last - first);
+}
+
+static double tempered(int note)
+{
+	return 440.0 * pow(2.0, (note - 10) / 12.0);	// Note 10 is A4
+}
+
+/*
+ *	checkNotes() checks the pitch of each note of a ringtone, and that its
+ *	pauses are silent. A note is heard from between DAC_BLOCK and
+ *	2*DAC_BLOCK samples after the timer starts it, as the DMA buffer being
+ *	filled is sent after the one playing, so each is checked from SEQ_GAP
+ *	ms (for a repeated note) and 2*DAC_BLOCK samples after it starts to
+ *	DAC_BLOCK samples after it ends. Pauses are checked from when the
+ *	longest release is over.
+ *
+ *	@param	worst		Set to the largest pitch error, in percent
+ *	@param	checked		Added to for each note and pause checked
+ *	@return				The number of notes wrong
+ */
+static int checkNotes(const TONE_Type *tone, double *worst, int *checked)
+{
+	int i, j, from, to, bad = 0;
+	uint32_t at = 0;
+	double hz, err;
+
+	*worst = 0;
+	for(i=0; i<tone->count; i++)
+	{
+		from = (at + SEQ_GAP)*MS_SAMPLES + 2*DAC_BLOCK;
+		to = (at + tone->events[i].ticks)*MS_SAMPLES + DAC_BLOCK;
+		at += tone->events[i].ticks;
+
+		if(tone->events[i].note == 0)
+		{
+			from += SYNTH_FALL_MAX*SYNTH_TICK;
+			if(from >= to) continue;
+			(*checked)++;
+			for(j=from; j<to; j++) if(rec[j] != 0) break;
+			if(j < to) bad++;
+			continue;
+		}
+
+		if(to - from < MIN_CYCLES*2*SYNTH_RATE/tempered(tone->events[i].note)) continue;
+		(*checked)++;
+		hz = pitch(from, to);
+		err = 100 * fabs(hz - tempered(tone->events[i].note)) / tempered(tone->events[i].note);
+		if(err > *worst) *worst = err;
+		if(err > PITCH_ERR) bad++;
+	}
+	return bad;
+}
+
+/*
+ *	readMorse() reads the beeps of the sound back as dots and dashes: a beep
+ *	ends at a millisecond of silence, and is a dash if it is more than two
+ *	dots long. The pitch of the middle half of each is checked.
+ *
+ *	@param	code		Set to the dots and dashes
+ *	@param	size		The size of code
+ *	@param	note		The note the beeps should be
+ *	@return				The number of beeps of the wrong pitch
+ */
+static int readMorse(char *code, int size, int note)
+{
+	int unit = 1200/MORSE_WPM*MS_SAMPLES;
+	int i = 0, start, quiet, n = 0, bad = 0;
+	double hz;
+
+	while(i < recLen)
+	{
+		while(i < recLen && rec[i] == 0) i++;
+		if(i >= recLen) break;
+		start = i;
+		for(quiet=0; i<recLen && quiet<MS_SAMPLES; i++) quiet = rec[i] ? 0 : quiet+1;
+		i -= quiet;
+
+		if(n < size-1) code[n++] = (i - start > 2*unit) ? '-' : '.';
+		hz = pitch(start + (i-start)/4, i - (i-start)/4);
+		if(100 * fabs(hz - tempered(note)) / tempered(note) > PITCH_ERR) bad++;
+	}
+	code[n] = '\0';
+	return bad;
+}
+
+static void put16(FILE *f, uint32_t v)
+{
+	fputc(v & 0xFF, f);
+	fputc((v >> 8) & 0xFF, f);
+}
+
+static void put32(FILE *f, uint32_t v)
+{
+	put16(f, v & 0xFFFF);
+	put16(f, v >> 16);
+}
+
+/*
+ *	writeWav() writes the sound rendered to dir/name.wav, as 16 bit mono
+ *	PCM. Characters of the name that are not letters or digits are written
+ *	as '_'.
+ */
+static void writeWav(const char *dir, const char *name)
+{
+	char path[256];
+	FILE *f;
+	int i, n;
+
+	if(dir == 0) return;
+	n = snprintf(path, sizeof(path), "%s/", dir);
+	for(i=0; name[i] && n < (int)sizeof(path)-5; i++)
+	{
+		path[n++] = (letter(name[i]) || digit(name[i])) ? name[i] : '_';
+	}
+	strcpy(&path[n], ".wav");
+
+	f = fopen(path, "wb");
+	if(f == 0)
+	{
+		printf("  cannot write %s\n", path);
+		return;
+	}
+	fwrite("RIFF", 1, 4, f);
+	put32(f, 36 + 2*recLen);
+	fwrite("WAVEfmt ", 1, 8, f);
+	put32(f, 16);						// Format chunk size
+	put16(f, 1);						// PCM
+	put16(f, 1);						// Mono
+	put32(f, SYNTH_RATE);
+	put32(f, 2*SYNTH_RATE);				// Bytes per second
+	put16(f, 2);						// Bytes per sample
+	put16(f, 16);						// Bits per sample
+	fwrite("data", 1, 4, f);
+	put32(f, 2*recLen);
+	for(i=0; i<recLen; i++) put16(f, (uint16_t)rec[i]);
+	fclose(f);
+}
+
+/*
+ *	playTone() plays a ringtone of the menu to the end, optionally with the
+ *	chime over it, and checks its timing.
+ *
+ *	@param	i			The ringtone
+ *	@param	chime		1 to call notify() CHIME_AT ms in
+ *	@param	events		Set to the ringtone's compiled notes
+ *	@return				1 if the timing is wrong, 0 if it is right
+ */
+static int playTone(int i, int chime, const TONE_Type **events)
+{
+	char text[1024];
+	const TONE_Type *tone;
+	uint32_t want = SEQ_TAIL;
+	double start;
+	int ms, q;
+
+	strncpy(text, ringtones[i].rtttl, sizeof(text)-1);
+	text[sizeof(text)-1] = '\0';
+	recLen = 0;
+
+	start = now();
+	rtttlDecode(text);
+	if(chime)
+	{
+		for(q=0; q<CHIME_AT; q++) simStep();
+		notify();
+	}
+	ms = finish(start);
+
+	*events = tone = toneFind(toneHash((uint8_t*)text, strlen(text)));
+	if(tone == 0) return 1;
+	for(q=0; q<tone->count; q++) want += tone->events[q].ticks;
+	if(ms != (int)want) printf("  %s: %d ms, should be %u\n", ringtones[i].title, ms, want);
+	return ms != (int)want;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dir = argc > 1 ? argv[1] : 0;
+	const TONE_Type *tone;
+	char code[64];
+	double worst, start;
+	int i, ms, checked = 0, badTime = 0, badPitch = 0, badMorse = 0;
+
+	MSYS_Init(heap, HEAP_SIZE);
+	arenaInit(&decodeArena, MSYS_Alloc(DECODE_ARENA), DECODE_ARENA);
+	init_seq();
+
+	printf("  %-16s %6s %8s %11s\n", "ringtone", "notes", "ms", "worst pitch");
+	for(i=0; i<RINGTONES; i++)
+	{
+		badTime += playTone(i, 0, &tone);
+		if(tone == 0) continue;
+		badPitch += checkNotes(tone, &worst, &checked);
+		printf("  %-16s %6d %8d %10.3f%%\n", ringtones[i].title, tone->count, recLen/MS_SAMPLES, worst);
+		writeWav(dir, ringtones[i].title);
+	}
+
+	badTime += playTone(0, 1, &tone);
+	printf("  %-16s %6d %8d\n", "with the chime", tone ? tone->count : 0, recLen/MS_SAMPLES);
+	writeWav(dir, "chime");
+
+	init_morse(MORSE_WPM);
+	recLen = 0;
+	start = now();
+	morseParse(MORSE_SENT);
+	ms = finish(start);
+	badMorse = readMorse(code, sizeof(code), toneNote(1, 5));
+	if(strcmp(code, MORSE_CODE) != 0) badMorse++;
+	if(ms != 33*1200/MORSE_WPM + SEQ_TAIL) badTime++;	// 3 dots and a gap, 3 dashes and a gap, and again
+	printf("  %-16s %6s %8d  read %s\n", "morse " MORSE_SENT, "", ms, code);
+	writeWav(dir, "morse");
+
+	printf("Rendered %.1f s of sound at %.0fx real time\n", simSeconds, simSeconds / simWall);
+	printf("Timing: %s\n", badTime ? "FAILED" : "ok");
+	printf("Pitch (%d notes and pauses within %.1f%%): %s\n", checked, PITCH_ERR, badPitch ? "FAILED" : "ok");
+	printf("Morse: %s\n", badMorse ? "FAILED" : "ok");
+	if(dir) printf("WAV files written to %s\n", dir);
+
+	free(rec);
+	return badTime || badPitch || badMorse;
+}
@@ -0,0 +1,101 @@
+/*	
+ *	@author		abradbury
+ *	
+ *	crc_bench.c is a host (Linux) benchmark for crc.c. It checks the slice-by-4 
+ *	kernel against a bit-at-a-time reference and then times it against the 
+ *	usual byte-wise table method, both for single 8 byte text blocks (the 
+ *	cost added to each received block) and for a full 2040 byte segment.
+ *
+ *	Build and run with 'make bench' from the top directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "crc.h"
+
+static uint32_t byteTable[256];
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+static uint32_t crc_bitwise(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+	int b;
+	crc = ~crc;
+	while(len--)
+	{
+		crc ^= *data++;
+		for(b=0; b<8; b++) crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+	}
+	return ~crc;
+}
+
+static uint32_t crc_bytewise(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+	crc = ~crc;
+	while(len--) crc = byteTable[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+/*	
+ *	run() times a CRC function over the buffer, fed in chunks of the given size 
+ *	as rx_text() does, and returns the time in nanoseconds per byte.
+ */
+static double run(uint32_t (*fn)(uint32_t, const uint8_t *, uint32_t),
+				  const uint8_t *buf, uint32_t len, uint32_t chunk, int reps, uint32_t *out)
+{
+	volatile uint32_t sink = 0;
+	double t0 = now();
+	int r;
+	for(r=0; r<reps; r++)
+	{
+		uint32_t crc = 0, pos;
+		for(pos=0; pos<len; pos+=chunk) crc = fn(crc, buf+pos, chunk);
+		sink ^= crc;
+	}
+	*out = sink;
+	return (now()-t0)/((double)reps*len);
+}
+
+int main(void)
+{
+	static uint8_t buf[2040];
+	uint32_t i, n, a, b;
+	int fail = 0;
+
+	for(n=0; n<256; n++)
+	{
+		uint32_t c = n, k;
+		for(k=0; k<8; k++) c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+		byteTable[n] = c;
+	}
+
+	srand(1);
+	for(i=0; i<sizeof(buf); i++) buf[i] = rand();
+
+	// Check every length up to 64 and a whole segment, and a known value
+	for(n=0; n<=64; n++)
+	{
+		if(crc32_update(0, buf, n) != crc_bitwise(0, buf, n)) fail = 1;
+	}
+	if(crc32_update(0, buf, sizeof(buf)) != crc_bitwise(0, buf, sizeof(buf))) fail = 1;
+	if(crc32_update(0, (const uint8_t*)"123456789", 9) != 0xCBF43926) fail = 1;
+	if(crc32_update(crc32_update(0, buf, 8), buf+8, 8) != crc32_update(0, buf, 16)) fail = 1;
+	printf("crc32 check: %s\n", fail ? "FAILED" : "ok");
+
+	printf("%-14s %12s %12s\n", "", "8 byte blocks", "2040 bytes");
+	double b8 = run(crc_bytewise, buf, sizeof(buf), 8, 20000, &a);
+	double bs = run(crc_bytewise, buf, sizeof(buf), sizeof(buf), 20000, &b);
+	printf("%-14s %9.3f ns/B %9.3f ns/B\n", "byte-wise", b8, bs);
+	double s8 = run(crc32_update, buf, sizeof(buf), 8, 20000, &a);
+	double ss = run(crc32_update, buf, sizeof(buf), sizeof(buf), 20000, &b);
+	printf("%-14s %9.3f ns/B %9.3f ns/B\n", "slice-by-4", s8, ss);
+	printf("speed up       %9.2fx     %9.2fx\n", b8/s8, bs/ss);
+
+	return fail;
+}
@@ -0,0 +1,287 @@
+/*
+ *	@author		abradbury
+ *
+ *	frame_bench.c is a host (Linux) benchmark of the path a received CAN
+ *	frame takes from CAN_IRQHandler() to the text decoder. It compares:
+ *
+ *	- copying: the frame is read into RMsg, packed into the buffer arrays
+ *	  (bufPut()), unpacked again (bufGet()) and passed by value to
+ *	  decipher(), pre(), rx_text() and the rest, as the station did before,
+ *	- in place: the frame is read straight into its buffer slot and lent to
+ *	  decipher() and the rest as a const pointer, as it does now.
+ *
+ *	The CAN controller registers and CAN_ReceiveMsg() are modelled after the
+ *	LPC17xx driver, and each handler does the same work in both versions
+ *	(rx_text() stores the 8 bytes at the block's place in the text), but the
+ *	terminal output in pre() and post() is left out. Each transfer is a start
+ *	of text, 255 blocks and an end of text, received as a burst and then
+ *	decoded from the buffer.
+ *
+ *	It is built with -O0, as the firmware is, so the copies are made as they
+ *	are on the board. Times are read with the x86 time stamp counter, which
+ *	counts at a fixed rate close to the core clock, around a whole burst or
+ *	a whole decode, and the fastest of REPS runs is kept.
+ *
+ *	Build and run with 'make bench' from the top directory.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "canbus_msg.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define BLOCKS		255			// Text blocks in each transfer
+#define FRAMES		(BLOCKS+2)	// With the start and end of text
+#define REPS		2000
+
+typedef struct {				// As in lpc17xx_can.h
+	uint32_t	id;
+	uint8_t		dataA[4];
+	uint8_t		dataB[4];
+	uint8_t		len;
+	uint8_t		format;
+	uint8_t		type;
+} CAN_MSG_Type;
+
+typedef struct {				// The receive registers of a CAN controller
+	volatile uint32_t RFS, RID, RDA, RDB, CMR;
+} CAN_REGS;
+
+static CAN_REGS		can;
+static CAN_MSG_Type	RMsg;
+static uint32_t		bufId[FRAMES];			// The packed buffer
+static uint8_t		bufData[FRAMES][8];
+static uint8_t		bufInfo[FRAMES];
+static CAN_MSG_Type	bufMsg[FRAMES];			// The buffer of slots
+static uint8_t		dataArray[8*BLOCKS];	// The text being put back together
+static uint32_t		rxCount, rxTotal;
+static int			bufMsgs, decMsgs;
+
+static uint64_t now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000000ull + ts.tv_nsec;
+#endif
+}
+
+/*
+ *	load() puts the next frame of a transfer into the controller registers.
+ */
+static void load(int n)
+{
+	uint32_t cmd = n == 0 ? CMD_STEXT : n == FRAMES-1 ? CMD_ETEXT : CMD_TEXTBLOCK;
+	can.RFS = (1u << 31) | (8 << 16);
+	can.RID = 0x10000000 | (cmd << 16) | ((n & 0xFF) << 8) | 0x47;
+	can.RDA = 0x64636261 + n;
+	can.RDB = 0x68676665;
+}
+
+/*
+ *	receive() reads the registers into a message, as CAN_ReceiveMsg() does.
+ */
+static void receive(CAN_REGS *regs, CAN_MSG_Type *msg)
+{
+	uint32_t data = regs->RFS;
+	msg->format	= (data >> 31) & 1;
+	msg->type	= (data >> 30) & 1;
+	msg->len	= (data >> 16) & 0x0F;
+	msg->id		= regs->RID;
+	data = regs->RDA;
+	msg->dataA[0] = data;		msg->dataA[1] = data >> 8;
+	msg->dataA[2] = data >> 16;	msg->dataA[3] = data >> 24;
+	data = regs->RDB;
+	msg->dataB[0] = data;		msg->dataB[1] = data >> 8;
+	msg->dataB[2] = data >> 16;	msg->dataB[3] = data >> 24;
+	regs->CMR = 0x04;			// Release the receive buffer
+}
+
+/*
+ *	The handlers passed a copy of the message.
+ */
+static void preCopy(CAN_MSG_Type msg, char t)	{ rxCount += t; }
+static void postCopy(CAN_MSG_Type msg)			{ rxTotal += CAN_GET_SOURCE_ADD(msg.id); }
+
+static void initCopy(CAN_MSG_Type msg)
+{
+	rxTotal = msg.dataA[0] | (msg.dataA[1] << 8);
+	rxCount = 0;
+}
+
+static void rxCopy(CAN_MSG_Type msg)
+{
+	uint32_t pos = 8*CAN_GET_COUNT(msg.id);
+	int j;
+	for(j=0; j<4; j++) dataArray[pos+j] = msg.dataA[j];
+	for(j=0; j<4; j++) dataArray[pos+j+4] = msg.dataB[j];
+	rxCount++;
+}
+
+static void endCopy(CAN_MSG_Type msg)			{ rxTotal += CAN_GET_TYPE(msg.id); }
+
+static void decipherCopy(CAN_MSG_Type msg, char t)
+{
+	switch(CAN_GET_CMD(msg.id))
+	{
+		case CMD_STEXT:		preCopy(msg, t); initCopy(msg); postCopy(msg); break;
+		case CMD_TEXTBLOCK:	rxCopy(msg); break;
+		case CMD_ETEXT:		preCopy(msg, t); endCopy(msg); postCopy(msg); break;
+	}
+}
+
+static void isrCopy(void)
+{
+	receive(&can, &RMsg);
+	bufId[bufMsgs] = RMsg.id;
+	memcpy(bufData[bufMsgs], RMsg.dataA, 4);
+	memcpy(bufData[bufMsgs]+4, RMsg.dataB, 4);
+	bufInfo[bufMsgs] = (RMsg.len & 0x0F) | ((RMsg.format & 1) << 4) | ((RMsg.type & 1) << 5);
+	bufMsgs++;
+}
+
+static void handlerCopy(void)
+{
+	CAN_MSG_Type msg;
+	while(decMsgs != bufMsgs)
+	{
+		msg.id = bufId[decMsgs];
+		memcpy(msg.dataA, bufData[decMsgs], 4);
+		memcpy(msg.dataB, bufData[decMsgs]+4, 4);
+		msg.len = bufInfo[decMsgs] & 0x0F;
+		msg.format = (bufInfo[decMsgs] >> 4) & 1;
+		msg.type = (bufInfo[decMsgs] >> 5) & 1;
+		decipherCopy(msg, 'r');
+		decMsgs++;
+	}
+}
+
+/*
+ *	The handlers lent the buffer slot.
+ */
+static void preSlot(const CAN_MSG_Type *msg, char t)	{ rxCount += t; }
+static void postSlot(const CAN_MSG_Type *msg)			{ rxTotal += CAN_GET_SOURCE_ADD(msg->id); }
+
+static void initSlot(const CAN_MSG_Type *msg)
+{
+	rxTotal = msg->dataA[0] | (msg->dataA[1] << 8);
+	rxCount = 0;
+}
+
+static void rxSlot(const CAN_MSG_Type *msg)
+{
+	uint32_t pos = 8*CAN_GET_COUNT(msg->id);
+	int j;
+	for(j=0; j<4; j++) dataArray[pos+j] = msg->dataA[j];
+	for(j=0; j<4; j++) dataArray[pos+j+4] = msg->dataB[j];
+	rxCount++;
+}
+
+static void endSlot(const CAN_MSG_Type *msg)			{ rxTotal += CAN_GET_TYPE(msg->id); }
+
+static void decipherSlot(const CAN_MSG_Type *msg, char t)
+{
+	switch(CAN_GET_CMD(msg->id))
+	{
+		case CMD_STEXT:		preSlot(msg, t); initSlot(msg); postSlot(msg); break;
+		case CMD_TEXTBLOCK:	rxSlot(msg); break;
+		case CMD_ETEXT:		preSlot(msg, t); endSlot(msg); postSlot(msg); break;
+	}
+}
+
+static void isrSlot(void)
+{
+	receive(&can, &bufMsg[bufMsgs]);
+	bufMsgs++;
+}
+
+static void handlerSlot(void)
+{
+	while(decMsgs != bufMsgs)
+	{
+		decipherSlot(&bufMsg[decMsgs], 'r');
+		decMsgs++;
+	}
+}
+
+static void isrNone(void)
+{
+	bufMsgs++;
+}
+
+/*
+ *	burst() times a burst of frames arriving, including loading the
+ *	registers for each one.
+ */
+static uint64_t burst(void (*isr)(void))
+{
+	uint64_t t0 = now();
+	int n;
+	for(n=0; n<FRAMES; n++)
+	{
+		load(n);
+		isr();
+	}
+	return now() - t0;
+}
+
+/*
+ *	run() receives and decodes transfers through one version of the path.
+ *	The time to load the registers, found with an interrupt that does
+ *	nothing, is taken off the interrupt time.
+ *
+ *	@param	isr, handler	The interrupt and buffer handler to use
+ *	@param	rx, dec			Set to the fastest time per frame for each half
+ */
+static void run(void (*isr)(void), void (*handler)(void), double *rx, double *dec)
+{
+	uint64_t t, best0 = ~0ull, best1 = ~0ull, bestLoad = ~0ull;
+	int r;
+	for(r=0; r<REPS; r++)
+	{
+		bufMsgs = decMsgs = 0;
+		t = burst(isrNone);
+		if(t < bestLoad) bestLoad = t;
+		bufMsgs = decMsgs = 0;
+		t = burst(isr);
+		if(t < best0) best0 = t;
+		t = now();
+		handler();
+		t = now() - t;
+		if(t < best1) best1 = t;
+	}
+	*rx = (double)(best0 - bestLoad) / FRAMES;
+	*dec = (double)best1 / FRAMES;
+}
+
+int main(void)
+{
+	static uint8_t copyText[sizeof(dataArray)];
+	double rxC, decC, rxS, decS;
+	int same;
+
+	run(isrCopy, handlerCopy, &rxC, &decC);
+	memcpy(copyText, dataArray, sizeof(dataArray));
+	memset(dataArray, 0, sizeof(dataArray));
+	run(isrSlot, handlerSlot, &rxS, &decS);
+	same = memcmp(copyText, dataArray, sizeof(dataArray)) == 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+	printf("Per frame, in TSC cycles (%d frames a transfer):\n", FRAMES);
+#else
+	printf("Per frame, in ns (%d frames a transfer):\n", FRAMES);
+#endif
+	printf("  %-10s %10s %10s %10s\n", "", "interrupt", "decode", "total");
+	printf("  %-10s %10.1f %10.1f %10.1f\n", "copying", rxC, decC, rxC+decC);
+	printf("  %-10s %10.1f %10.1f %10.1f\n", "in place", rxS, decS, rxS+decS);
+	printf("  saving     %9.0f%%\n", 100.0*(1 - (rxS+decS)/(rxC+decC)));
+	printf("Decoded text matches: %s\n", same ? "ok" : "FAILED");
+
+	return !same;
+}
@@ -0,0 +1,282 @@
+/*
+ *	@author		abradbury
+ *
+ *	msys_bench.c is a host (Linux) benchmark suite for mysys.c. It runs a set
+ *	of workloads through MSYS_Alloc(), MSYS_Free() and MSYS_Compact() and
+ *	through a copy of the original compacting allocator, over the same 16 KB
+ *	heap the station uses, and prints for each:
+ *
+ *	- the time per call (mean, median, 99th percentile and worst case),
+ *	- the allocation failure rate,
+ *	- with MSYS_STATS defined, the fragmentation of the free space sampled
+ *	  at ten points through the run.
+ *
+ *	The workloads are text reassembly buffers, ringtone buffers, bursts of
+ *	messages freed out of order, a random mix of all of these with up to 12
+ *	blocks live, and a trace of the calls the firmware makes when sending and
+ *	receiving the built in ringtones and some texts. The trace was derived
+ *	from text.c and the ringtone lengths in menu.c rather than recorded.
+ *
+ *	Each call is timed on its own, so the figures include the clock read (a
+ *	few tens of ns); compare the columns, not the absolute values. Every
+ *	workload is run REPS times and the fastest time for each call is kept, so
+ *	that a timer interrupt or page fault on the host is not mistaken for a
+ *	slow call. The contents of every live block are checked before it is
+ *	freed, to catch blocks that overlap.
+ *
+ *	'make bench' builds and runs this twice: bench/msys_bench for the times
+ *	and bench/msys_frag_bench, with MSYS_STATS, for the fragmentation (as the
+ *	instrumentation adds to the times).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "mysys.h"
+#include "msys_legacy.h"
+
+#define HEAP		0x4000		// Same size as the station heap
+#define SLOTS		32			// Most blocks a workload can have live
+#define OPS			100000		// Calls per workload
+#define REPS		5			// Runs of each workload, the fastest of each call is kept
+#define SAMPLES		10			// Fragmentation samples per workload
+#define COMPACT		-1			// Returned by a workload to call the compact routine
+
+typedef struct {
+	void	(*init)(void *, unsigned);
+	void*	(*alloc)(unsigned);
+	void	(*free)(void *);
+	void	(*compact)(void);
+	void	(*stats)(unsigned *, unsigned *);
+	const char *name;
+} ALLOCATOR;
+
+typedef struct {
+	int		(*next)(int op, unsigned *size);
+	const char *name;
+} WORKLOAD;
+
+static double heap[HEAP/sizeof(double)];
+static double tAlloc[OPS], tFree[OPS], tCompact[OPS];
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+/*
+ *	The ringtone buffers: tx_ringtone() allocates strlen()+8 to encode into,
+ *	init_text() allocates the encoded length +1 at the receiver.
+ */
+static const unsigned ringTx[] = {239, 86, 72, 238, 163, 218, 163, 226, 70, 197};
+static const unsigned ringRx[] = {70, 33, 27, 80, 48, 57, 55, 63, 22, 50};
+static const unsigned textLen[] = {12, 5, 31, 160, 44, 9, 88, 23, 140, 61};
+
+static unsigned textSize(void)
+{
+	if(rand() % 20)	return 8*(1 + rand()%40) + 1;		// Up to 40 blocks
+	return 8*(41 + rand()%214) + 1;					// Up to a whole segment
+}
+
+static unsigned ringSize(void)
+{
+	int r = rand() % 10;
+	return (rand() & 1) ? ringTx[r] : ringRx[r];
+}
+
+/*
+ *	Each workload returns the slot to use for the next call: the block in it
+ *	is freed if it is live, else a block of *size bytes is allocated into it.
+ */
+static int wlText(int op, unsigned *size)
+{
+	*size = textSize();
+	return rand() % 2;
+}
+
+static int wlRingtone(int op, unsigned *size)
+{
+	*size = ringSize();
+	return rand() % 2;
+}
+
+static int wlBurst(int op, unsigned *size)
+{
+	int p = op % 33;
+	*size = (rand() & 1) ? textSize() : ringSize();
+	if(p == 32)	return COMPACT;					// Compact after each burst
+	if(p < 16)	return p;						// 16 messages arrive,
+	return ((p-16)*7) % 16;						// then are freed out of order
+}
+
+static int wlMix(int op, unsigned *size)
+{
+	int r = rand() % 100;
+	if(r < 70)		*size = 8*(1 + rand()%20) + 1;
+	else if(r < 90)	*size = 20 + rand()%100;
+	else if(r < 97)	*size = 8*(20 + rand()%80) + 1;
+	else			*size = 2040 + rand()%2041;
+	return rand() % 12;
+}
+
+/*
+ *	wlTrace() steps through a session: each ringtone is sent (its encode
+ *	buffer is allocated and freed around the transfer) while a text is being
+ *	received, then a ringtone is received and played.
+ */
+static int wlTrace(int op, unsigned *size)
+{
+	int n = (op / 6) % 10;
+	switch(op % 6)
+	{
+		case 0:	*size = 8*((textLen[n]+7)/8) + 1;	return 0;	// Text arrives
+		case 1:	*size = ringTx[n];					return 1;	// Ringtone encoded
+		case 2:										return 1;	// and sent
+		case 3:										return 0;	// Text shown
+		case 4:	*size = ringRx[(n+3) % 10];			return 2;	// Ringtone arrives
+		default:									return 2;	// and is played
+	}
+}
+
+static int cmp(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+static void report(const char *who, const char *what, double *t, int n)
+{
+	double sum = 0;
+	int i;
+	if(n == 0) return;
+	for(i=0; i<n; i++) sum += t[i];
+	qsort(t, n, sizeof(double), cmp);
+	printf("  %-20s %-8s %8.1f %8.1f %8.1f %8.1f\n", who, what, sum/n, t[n/2], t[n*99/100], t[n-1]);
+}
+
+static void keep(double *t, int n, double v, int rep)
+{
+	if(rep == 0 || v < t[n]) t[n] = v;
+}
+
+/*
+ *	run() plays a workload through an allocator.
+ *
+ *	@return				The number of blocks found overwritten
+ */
+static int run(const ALLOCATOR *a, const WORKLOAD *w)
+{
+	uint8_t *live[SLOTS];
+	unsigned size[SLOTS], want = 0, k;
+	unsigned frag[SAMPLES];
+	int na, nf, nc, fails, bad = 0, op, s, rep;
+	double t0;
+
+	for(rep=0; rep<REPS; rep++)
+	{
+		memset(live, 0, sizeof(live));
+		na = nf = nc = fails = 0;
+		srand(1);
+		a->init(heap, HEAP);
+
+		for(op=0; op<OPS; op++)
+		{
+			s = w->next(op, &want);
+			if(s == COMPACT)
+			{
+				t0 = now();
+				a->compact();
+				keep(tCompact, nc++, now()-t0, rep);
+			}
+			else if(live[s])
+			{
+				for(k=0; k<size[s]; k++) if(live[s][k] != (uint8_t)s) { bad++; break; }
+				t0 = now();
+				a->free(live[s]);
+				keep(tFree, nf++, now()-t0, rep);
+				live[s] = 0;
+			}
+			else
+			{
+				size[s] = want;
+				t0 = now();
+				live[s] = a->alloc(size[s]);
+				keep(tAlloc, na++, now()-t0, rep);
+				if(live[s])	memset(live[s], s, size[s]);
+				else		fails++;
+			}
+
+			if(rep == 0 && a->stats && op % (OPS/SAMPLES) == OPS/SAMPLES-1)
+			{
+				unsigned free, largest;
+				a->stats(&free, &largest);
+				frag[op / (OPS/SAMPLES)] = free ? 100 - largest*100/free : 0;
+			}
+		}
+		for(s=0; s<SLOTS; s++) a->free(live[s]);
+	}
+
+	if(a->stats)
+	{
+		printf("  %-20s %5.2f%% failed, fragmentation %%:", a->name, 100.0*fails/na);
+		for(k=0; k<SAMPLES; k++) printf(" %3u", frag[k]);
+		printf("\n");
+	}
+	else
+	{
+		report(a->name, "alloc", tAlloc, na);
+		report("", "free", tFree, nf);
+		report("", "compact", tCompact, nc);
+		printf("  %-20s %-8s %d of %d (%.2f%%)\n", "", "failed", fails, na, 100.0*fails/na);
+	}
+	return bad;
+}
+
+#ifdef MSYS_STATS
+static void msysStats(unsigned *free, unsigned *largest)
+{
+	MSYS_STATS_Type s;
+	MSYS_Stats(&s);
+	*free = s.free;
+	*largest = s.largest;
+}
+
+static void *msysAlloc(unsigned size)
+{
+	return MSYS_Alloc(size);				// A macro when MSYS_STATS is defined
+}
+#endif
+
+int main(void)
+{
+	const WORKLOAD work[] = {
+		{wlText,		"text reassembly"},
+		{wlRingtone,	"ringtones"},
+		{wlBurst,		"bursts of 16"},
+		{wlMix,			"random mix, 12 live"},
+		{wlTrace,		"firmware trace"},
+	};
+#ifdef MSYS_STATS
+	const ALLOCATOR legacy = {LEGACY_Init, LEGACY_Alloc, LEGACY_Free, LEGACY_Compact, LEGACY_Stats, "legacy (compacting)"};
+	const ALLOCATOR tlsf = {MSYS_Init, msysAlloc, MSYS_Free, MSYS_Compact, msysStats, "MSYS (TLSF)"};
+#else
+	const ALLOCATOR legacy = {LEGACY_Init, LEGACY_Alloc, LEGACY_Free, LEGACY_Compact, 0, "legacy (compacting)"};
+	const ALLOCATOR tlsf = {MSYS_Init, MSYS_Alloc, MSYS_Free, MSYS_Compact, 0, "MSYS (TLSF)"};
+#endif
+	int bad = 0, i;
+
+	for(i=0; i<sizeof(work)/sizeof(work[0]); i++)
+	{
+		printf("%s\n", work[i].name);
+		if(!legacy.stats) printf("  %-20s %-8s %8s %8s %8s %8s  ns\n", "", "", "mean", "p50", "p99", "worst");
+		run(&legacy, &work[i]);
+		bad += run(&tlsf, &work[i]);
+	}
+	printf("MSYS integrity: %s\n", bad ? "FAILED" : "ok");
+
+	return bad != 0;
+}
@@ -0,0 +1,151 @@
+/*	
+ *	@author		abradbury
+ *	
+ *	msys_legacy.c is a copy of the original MSYS bump allocator (with its 
+ *	compacting scan), kept so the host benchmarks can compare against it. The 
+ *	only changes are the LEGACY_ prefix and pointer casts through uintptr_t so 
+ *	it runs on a 64 bit host.
+ */
+
+#include <stdint.h>
+#include "msys_legacy.h"
+#define USED 1
+
+typedef struct {
+  unsigned size;
+} UNIT;
+
+typedef struct {
+  UNIT* free;
+  UNIT* heap;
+} MSYS;
+
+static MSYS msys;
+
+static UNIT* compact( UNIT *p, unsigned nsize )
+{
+       unsigned bsize, psize;
+       UNIT *best;
+
+       best = p;
+       bsize = 0;
+
+       while( psize = p->size, psize )
+       {
+              if( psize & USED )
+              {
+                  if( bsize != 0 )
+                  {
+                      best->size = bsize;
+                      if( bsize >= nsize )
+                      {
+                          return best;
+                      }
+                  }
+                  bsize = 0;
+                  best = p = (UNIT *)( (uintptr_t)p + (psize & ~USED) );
+              }
+              else
+              {
+                  bsize += psize;
+                  p = (UNIT *)( (uintptr_t)p + psize );
+              }
+       }
+
+       if( bsize != 0 )
+       {
+           best->size = bsize;
+           if( bsize >= nsize )
+           {
+               return best;
+           }
+       }
+
+       return 0;
+}
+
+void LEGACY_Free( void *ptr )
+{
+     if( ptr )
+     {
+         UNIT *p;
+
+         p = (UNIT *)( (uintptr_t)ptr - sizeof(UNIT) );
+         p->size &= ~USED;
+     }
+}
+
+void *LEGACY_Alloc( unsigned size )
+{
+     unsigned fsize;
+     UNIT *p;
+
+     if( size == 0 ) return 0;
+
+     size  += 3 + sizeof(UNIT);
+     size >>= 2;
+     size <<= 2;
+
+     if( msys.free == 0 || size > msys.free->size )
+     {
+         msys.free = compact( msys.heap, size );
+         if( msys.free == 0 ) return 0;
+     }
+
+     p = msys.free;
+     fsize = msys.free->size;
+
+     if( fsize >= size + sizeof(UNIT) )
+     {
+         msys.free = (UNIT *)( (uintptr_t)p + size );
+         msys.free->size = fsize - size;
+     }
+     else
+     {
+         msys.free = 0;
+         size = fsize;
+     }
+
+     p->size = size | USED;
+
+     return (void *)( (uintptr_t)p + sizeof(UNIT) );
+}
+
+void LEGACY_Init( void *heap, unsigned len )
+{
+     len  += 3;
+     len >>= 2;
+     len <<= 2;
+     msys.free = msys.heap = (UNIT *) heap;
+     msys.free->size = msys.heap->size = len - sizeof(UNIT);
+     *(unsigned *)((char *)heap + len - 4) = 0;
+}
+
+void LEGACY_Compact( void )
+{
+     msys.free = compact( msys.heap, 0x7FFFFFFF );
+}
+
+/*
+ *	LEGACY_Stats() is not part of the original allocator; it walks the heap
+ *	for the benchmarks. Neighbouring free blocks count as one, as compact()
+ *	would merge them.
+ */
+void LEGACY_Stats( unsigned *free, unsigned *largest )
+{
+     UNIT *p = msys.heap;
+     unsigned psize, run = 0;
+
+     *free = *largest = 0;
+     while( psize = p->size, psize )
+     {
+         if( psize & USED ) run = 0;
+         else
+         {
+             run += psize;
+             *free += psize;
+             if( run > *largest ) *largest = run;
+         }
+         p = (UNIT *)( (uintptr_t)p + ( psize & ~USED ) );
+     }
+}
@@ -0,0 +1,12 @@
+/*	
+ *	@author		abradbury
+ */
+
+#ifndef __MSYS_LEGACY_H
+#define __MSYS_LEGACY_H
+extern void LEGACY_Free( void *ptr );
+extern void *LEGACY_Alloc( unsigned size );
+extern void LEGACY_Init( void *heap, unsigned len );
+extern void LEGACY_Compact( void );
+extern void LEGACY_Stats( unsigned *free, unsigned *largest );
+#endif
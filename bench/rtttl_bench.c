@@ -0,0 +1,520 @@
+/*
+ *	@author		abradbury
+ *
+ *	rtttl_bench.c is a host (Linux) benchmark for rtttl.c. It parses a corpus
+ *	of RTTTL ringtones with the one pass parser and with a copy of the three
+ *	pass parser music.c used before (rtttlSplit(), rtttlDefaults() and
+ *	rtttlData(), without the terminal output), checks that both read the
+ *	same notes, and prints the notes parsed per second by each.
+ *
+ *	The corpus is the ringtones of the menu (ringtones.c) and CORPUS generated
+ *	ringtones of 20 to 200 notes each, with random durations, sharps, dots
+ *	and octaves, written the way the old parser needs them (defaults in
+ *	d, o, b order). The whole corpus is parsed REPS times and the fastest run
+ *	is kept.
+ *
+ *	It then checks the parser against the RTTTL specification, with the
+ *	cases[] below, which each cover a corner of it, and a conformance corpus
+ *	of CONFORM generated ringtones written every way the specification
+ *	allows: defaults in any order, left out or with long keys, letters of
+ *	either case, durations 1 to 32, octaves 4 to 7, 25 to 900 beats per
+ *	minute, the dot before or after the octave and white space anywhere.
+ *	Each is generated with the notes it should give, and the corpus is
+ *	also timed, in notes and bytes parsed per second.
+ *
+ *	Last it checks that ringtoneFind() finds the library's ringtones by
+ *	title and by RTTTL name, in any case, and nothing else.
+ *
+ *	Build and run with 'make bench' from the top directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rtttl.h"
+#include "ringtones.h"
+
+#define CORPUS		2000		// Generated ringtones
+#define MAXLEN		2048		// Longest ringtone text
+#define MAXNOTES	512			// Most notes in a ringtone
+#define REPS		10
+#define CONFORM		5000		// Generated ringtones of the conformance corpus
+
+typedef struct {
+	int		pitch, octave, dur, dot;
+} NOTE;
+
+#define BUILTIN		RINGTONES
+
+static char		*corpus[BUILTIN+CORPUS];
+static char		*conformCorpus[CONFORM], *conformWant[CONFORM];
+static RTTTL_PARSER	parser;		// The one pass parser, kept for show()
+static int		parsed;			// What rtttlEnd() gave
+static NOTE		oldNotes[MAXNOTES], newNotes[MAXNOTES];
+static int		oldCount, newCount;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+/*
+ *	The three pass parser, as it was in music.c.
+ */
+static char		name[32], defaults[32], data[MAXLEN];
+static int		ddur, doct, dbpm, k;
+static const char	letters[12] = {'c','j','d','k','e','f','m','g','n','a','h','b'};
+
+static int between(char low, char high, char check)	{ return low <= check && high >= check; }
+static int letter(char test)	{ return between('a','z', test) || between('A','Z',test); }
+static int digit(char test)		{ return between('0','9', test); }
+
+static void rtttlSplit(char str[])
+{
+	int i=0,j=0;
+	while(str[i] != ':' && str[i] != '\0')
+	{
+		if(j < 31) name[j++] = str[i];
+		i++;
+	}
+	name[j] = '\0';
+	if(str[i] == ':') i++;
+	j = 0;
+	while(str[i] != ':' && str[i] != '\0')
+	{
+		if(j < 30) defaults[j++] = str[i];
+		i++;
+	}
+	defaults[j++] = ',';
+	defaults[j] = '\0';
+	if(str[i] == ':') i++;
+	k = 0;
+	while(str[i] != '\0' && k < MAXLEN-2) data[k++] = str[i++];
+	data[k++] = ',';
+	data[k] = '\0';
+}
+
+static void rtttlDefaults(void)
+{
+	int p = 0;
+	ddur = doct = dbpm = 0;
+	while(defaults[p] != ',')
+	{
+		if(digit(defaults[p]) && ddur == 0) ddur = defaults[p]-48;
+		else if(digit(defaults[p]) && ddur != 0) ddur = ddur*10 + defaults[p]-48;
+		p++;
+	}
+	p++;
+	while(defaults[p] != ',')
+	{
+		if(digit(defaults[p]) && doct == 0) doct = defaults[p]-48;
+		p++;
+	}
+	p++;
+	while(defaults[p] != ',')
+	{
+		if(digit(defaults[p]) && dbpm == 0) dbpm = defaults[p]-48;
+		else if(digit(defaults[p]) && dbpm < 100) dbpm = dbpm*10 + defaults[p]-48;
+		p++;
+	}
+}
+
+static void rtttlData(void)
+{
+	int q, dot = 0, j;
+	char val, msbDur = '0';
+	char tmparray[3] = {'0','0','0'};
+
+	oldCount = 0;
+	for(q=0; q<k; q++)
+	{
+		val = data[q];
+		if(val != ',')
+		{
+			if(digit(val) && letter(data[q+1]))		tmparray[0] = val;
+			else if(digit(val) && digit(data[q+1]))	msbDur = val;
+			else if(letter(val))					tmparray[1] = val;
+			else if(digit(val))						tmparray[2] = val;
+			else if(val == '#')						tmparray[1] = tmparray[1] + 7;
+			else if(val == '.')						dot = 1;
+		}
+		else
+		{
+			if(tmparray[2] == '0') tmparray[2] = (char)doct+48;
+			if(tmparray[0] == '0') tmparray[0] = (char)ddur+48;
+			if(oldCount < MAXNOTES)
+			{
+				oldNotes[oldCount].pitch = 0;
+				for(j=0; j<12; j++) if(letters[j] == tmparray[1]) oldNotes[oldCount].pitch = j+1;
+				oldNotes[oldCount].octave = tmparray[2]-48;
+				oldNotes[oldCount].dur = (msbDur != '0' ? (msbDur-48)*10 : 0) + tmparray[0]-48;
+				oldNotes[oldCount].dot = dot;
+				oldCount++;
+			}
+			tmparray[0] = tmparray[1] = tmparray[2] = '0';
+			dot = 0;
+			msbDur = '0';
+		}
+	}
+}
+
+static void parseOld(char *str)
+{
+	rtttlSplit(str);
+	rtttlDefaults();
+	rtttlData();
+}
+
+/*
+ *	The one pass parser.
+ */
+static void note(RTTTL_PARSER *p, int pitch, int octave, int dur, int dot)
+{
+	if(newCount < MAXNOTES)
+	{
+		newNotes[newCount].pitch = pitch;
+		newNotes[newCount].octave = octave;
+		newNotes[newCount].dur = dur;
+		newNotes[newCount].dot = dot;
+		newCount++;
+	}
+}
+
+static void parseNew(char *str)
+{
+	newCount = 0;
+	rtttlInit(&parser, note, 0);
+	rtttlFeed(&parser, str, strlen(str));
+	parsed = rtttlEnd(&parser);
+}
+
+/*
+ *	The conformance tests.
+ */
+static const char	*pitchNames[13] = {"p","c","c#","d","d#","e","f","f#","g","g#","a","a#","b"};
+
+/*
+ *	The corners of the specification, and what each should be read as, as
+ *	written by show().
+ */
+static const char	*cases[][2] = {
+	{"nokiatune:d=4,o=5,b=112:8e6,8d6,f#",			"nokiatune|4,5,112|8e6,8d6,4f#5"},
+	{"  Star Trek :d=4,o=5,b=063:8f.,16a#,d#.6",	"Star Trek|4,5,63|8f5.,16a#5,4d#6."},
+	{"dots::8c.6,8c6.,c.,p.",						"dots|4,5,63|8c6.,8c6.,4c5.,4p."},
+	{"octaves:o=4:c,c5,c6,c7,c8,c3,c10",			"octaves|4,4,63|4c4,4c5,4c6,4c7,4c4,4c4,4c4"},
+	{"durations:d=32:1c,2c,4c,8c,16c,32c,3c,64c,0c",	"durations|32,5,63|1c5,2c5,4c5,8c5,16c5,32c5,32c5,32c5,32c5"},
+	{"fast:b=900:c",								"fast|4,5,900|4c5"},
+	{"too fast:b=901:c",							"too fast|4,5,63|4c5"},
+	{"slow:b=25:c",									"slow|4,5,25|4c5"},
+	{"too slow:b=24:c",								"too slow|4,5,63|4c5"},
+	{"bad defaults:d=3,o=8,b=0:c",					"bad defaults|4,5,63|4c5"},
+	{"order:b=200,o=6,d=16:c",						"order|16,6,200|16c6"},
+	{"long keys:Duration=8,OCTAVE=6,bpm=200:C",		"long keys|8,6,200|8c6"},
+	{"\t space \r\n: d = 8 , o = 6 , b = 1 2 0 :\r\n c , 1 6 d#\t. 7 ,\n p",
+													"space|8,6,120|8c6,16d#7.,8p"},
+	{"sharps::c#,d#,f#,g#,a#,e#,b#,h,H#",			"sharps|4,5,63|4c#5,4d#5,4f#5,4g#5,4a#5,4f5,4b5,4b5,4b5"},
+	{"commas::,c,,d,",								"commas|4,5,63|4c5,4d5"},
+	{"no notes:d=8:",								"no notes|8,5,63|"},
+	{"no defaults::",								"no defaults|4,5,63|"},
+	{"an overlong name of more than 31 chars::c",	"an overlong name of more than 3|4,5,63|4c5"},
+	{"not rtttl",									"-"},
+	{"one colon:c,d",								"-"},
+};
+
+#define CASES		(int)(sizeof(cases)/sizeof(cases[0]))
+
+/*
+ *	Names for ringtoneFind(), and the title of the ringtone each should find,
+ *	0 for none.
+ */
+static const char	*finds[][2] = {
+	{"Star Wars",		"Star Wars"},
+	{"stwars",			"Star Wars"},
+	{"STAR TREK",		"Star Trek"},
+	{"nokiatune",		"Nokia Tune"},
+	{"Nokia Tune",		"Nokia Tune"},
+	{"JamesBond",		"James Bond"},
+	{"Insepect",		"Inspect Gadget"},
+	{"James",			0},
+	{"Star Wars!",		0},
+	{"StWars:",			0},
+	{"",				0},
+};
+
+#define FINDS		(int)(sizeof(finds)/sizeof(finds[0]))
+
+/*
+ *	show() writes what the one pass parser read, as
+ *	name|duration,octave,bpm|notes, each note as its duration, pitch,
+ *	octave (not for a pause) and a '.' if it is dotted, or "-" if it was
+ *	not RTTTL.
+ */
+static void show(char *out)
+{
+	int i;
+	if(parsed < 0)
+	{
+		strcpy(out, "-");
+		return;
+	}
+	out += sprintf(out, "%s|%d,%d,%d|", parser.name, parser.dur, parser.oct, parser.bpm);
+	for(i=0; i<newCount; i++)
+	{
+		out += sprintf(out, "%s%d%s", i ? "," : "", newNotes[i].dur, pitchNames[newNotes[i].pitch]);
+		if(newNotes[i].pitch) out += sprintf(out, "%d", newNotes[i].octave);
+		if(newNotes[i].dot) *out++ = '.';
+	}
+	*out = '\0';
+}
+
+/*
+ *	space() writes nothing half the time, otherwise some white space.
+ *
+ *	@return				The number of characters written
+ */
+static int space(char *str)
+{
+	static const char *spaces[5] = {" ", "  ", "\t", "\r\n", "\n"};
+	if(rand() % 2) return 0;
+	return sprintf(str, "%s", spaces[rand()%5]);
+}
+
+/*
+ *	number() writes a number, now and then with white space between its
+ *	digits.
+ */
+static int number(char *str, int val)
+{
+	char digits[8];
+	int i, len = 0;
+	sprintf(digits, "%d", val);
+	for(i=0; digits[i]; i++)
+	{
+		if(i && rand() % 16 == 0) len += space(str+len);
+		str[len++] = digits[i];
+	}
+	return len;
+}
+
+/*
+ *	mixedCase() writes a word in random case.
+ */
+static int mixedCase(char *str, const char *word)
+{
+	int i;
+	for(i=0; word[i]; i++) str[i] = rand() % 2 ? word[i] - 'a' + 'A' : word[i];
+	return i;
+}
+
+/*
+ *	conform() writes a random ringtone of the conformance corpus, and what
+ *	it should be read as.
+ *
+ *	@param	n			Its number, for its name
+ *	@param	want		Set to what it should be read as, see show()
+ *	@return				The ringtone
+ */
+static char *conform(int n, char **want)
+{
+	static const int durs[6] = {1, 2, 4, 8, 16, 32};
+	static const char *keys[3][2] = {{"d", "duration"}, {"o", "octave"}, {"b", "bpm"}};
+	static const char *letterNames[13] = {"p","c","c","d","d","e","f","f","g","g","a","a","b"};
+	char *str = malloc(MAXLEN), *exp = malloc(MAXLEN);
+	int len = 0, elen, vals[3], order[3] = {0, 1, 2};
+	int notes = 20 + rand() % 181, given = 0;
+	int i, k, t, pitch, dur, oct, dot;
+
+	vals[0] = durs[rand()%6];
+	vals[1] = 4 + rand()%4;
+	vals[2] = 25 + rand()%876;
+	for(i=2; i>0; i--)
+	{
+		k = rand() % (i+1);
+		t = order[i]; order[i] = order[k]; order[k] = t;
+	}
+
+	len += space(str+len);
+	len += sprintf(str+len, "Tone %d", n);
+	len += space(str+len);
+	str[len++] = ':';
+	for(i=0; i<3; i++)
+	{
+		k = order[i];
+		if(rand() % 4 == 0)
+		{
+			vals[k] = k == 0 ? 4 : k == 1 ? 5 : 63;		// Not given, the default is used
+			continue;
+		}
+		if(given++) str[len++] = ',';
+		len += space(str+len);
+		len += mixedCase(str+len, keys[k][rand()%4 == 0]);
+		len += space(str+len);
+		str[len++] = '=';
+		len += space(str+len);
+		len += number(str+len, vals[k]);
+		len += space(str+len);
+	}
+	str[len++] = ':';
+	elen = sprintf(exp, "Tone %d|%d,%d,%d|", n, vals[0], vals[1], vals[2]);
+
+	for(i=0; i<notes && len < MAXLEN-40; i++)
+	{
+		pitch = rand() % 13;
+		dur = rand() % 2 ? durs[rand()%6] : 0;
+		oct = rand() % 2 ? 4 + rand()%4 : 0;
+		dot = rand() % 4 == 0 ? 1 + rand()%2 : 0;			// 1 for before the octave, 2 for after
+
+		len += space(str+len);
+		if(dur) len += number(str+len, dur);
+		len += space(str+len);
+		if(pitch == 12 && rand() % 4 == 0) len += mixedCase(str+len, "h");
+		else len += mixedCase(str+len, letterNames[pitch]);
+		if(strlen(pitchNames[pitch]) > 1) str[len++] = '#';
+		len += space(str+len);
+		if(dot == 1) str[len++] = '.';
+		if(oct) len += number(str+len, oct);
+		if(dot == 2) str[len++] = '.';
+		len += space(str+len);
+		if(i < notes-1) str[len++] = ',';
+
+		elen += sprintf(exp+elen, "%s%d%s", i ? "," : "", dur ? dur : vals[0], pitchNames[pitch]);
+		if(pitch) elen += sprintf(exp+elen, "%d", oct ? oct : vals[1]);
+		if(dot) exp[elen++] = '.';
+	}
+	str[len] = '\0';
+	exp[elen] = '\0';
+	*want = exp;
+	return str;
+}
+
+/*
+ *	generate() writes a random ringtone.
+ */
+static char *generate(int n)
+{
+	static const int durs[6] = {1, 2, 4, 8, 16, 32};
+	static const char *pitches[13] = {"p","c","c#","d","d#","e","f","f#","g","g#","a","a#","b"};
+	char *str = malloc(MAXLEN);
+	int len, notes = 20 + rand() % 181, i;
+
+	len = sprintf(str, "gen%d:d=%d,o=%d,b=%d:", n, durs[rand()%6], 4 + rand()%4, 40 + rand()%260);
+	for(i=0; i<notes && len < MAXLEN-16; i++)
+	{
+		if(rand() % 2) len += sprintf(str+len, "%d", durs[rand()%6]);
+		len += sprintf(str+len, "%s", pitches[rand()%13]);
+		if(rand() % 8 == 0) len += sprintf(str+len, ".");
+		if(rand() % 2) len += sprintf(str+len, "%d", 4 + rand()%4);
+		if(i < notes-1) str[len++] = ',';
+	}
+	str[len] = '\0';
+	return str;
+}
+
+/*
+ *	run() parses a whole corpus REPS times.
+ *
+ *	@param	count		Set to the notes parsed in a run
+ *	@return				The notes parsed per second in the fastest run
+ */
+static double run(void (*parse)(char *), char **list, int n, int *count)
+{
+	double t, best = 1e30;
+	int r, i;
+	for(r=0; r<REPS; r++)
+	{
+		*count = 0;
+		t = now();
+		for(i=0; i<n; i++)
+		{
+			parse(list[i]);
+			*count += parse == parseOld ? oldCount : newCount;
+		}
+		t = now() - t;
+		if(t < best) best = t;
+	}
+	return *count / (best/1e9);
+}
+
+int main(void)
+{
+	int i, j, bad = 0, badCases = 0, badConform = 0, badFinds = 0, notesOld, notesNew, notesConform;
+	long bytes = 0, conformBytes = 0;
+	double rateOld, rateNew, rateConform;
+	static char got[8*MAXLEN];
+
+	srand(1);
+	for(i=0; i<BUILTIN; i++) corpus[i] = (char *) ringtones[i].rtttl;
+	for(i=0; i<CORPUS; i++) corpus[BUILTIN+i] = generate(i);
+	for(i=0; i<BUILTIN+CORPUS; i++) bytes += strlen(corpus[i]);
+
+	for(i=0; i<BUILTIN+CORPUS; i++)
+	{
+		parseOld(corpus[i]);
+		parseNew(corpus[i]);
+		if(oldCount != newCount) bad++;
+		else for(j=0; j<newCount; j++)
+		{
+			if(memcmp(&oldNotes[j], &newNotes[j], sizeof(NOTE)) != 0) { bad++; break; }
+		}
+	}
+
+	rateOld = run(parseOld, corpus, BUILTIN+CORPUS, &notesOld);
+	rateNew = run(parseNew, corpus, BUILTIN+CORPUS, &notesNew);
+
+	for(i=0; i<CASES; i++)
+	{
+		parseNew((char *) cases[i][0]);
+		show(got);
+		if(strcmp(got, cases[i][1]) != 0)
+		{
+			printf("  case %d: read %s, should be %s\n", i, got, cases[i][1]);
+			badCases++;
+		}
+	}
+
+	for(i=0; i<CONFORM; i++)
+	{
+		conformCorpus[i] = conform(i, &conformWant[i]);
+		conformBytes += strlen(conformCorpus[i]);
+	}
+	for(i=0; i<CONFORM; i++)
+	{
+		parseNew(conformCorpus[i]);
+		show(got);
+		if(strcmp(got, conformWant[i]) != 0)
+		{
+			if(badConform < 4) printf("  ringtone %d: read %s\n  should be %s\n", i, got, conformWant[i]);
+			badConform++;
+		}
+	}
+	rateConform = run(parseNew, conformCorpus, CONFORM, &notesConform);
+
+	for(i=0; i<FINDS; i++)
+	{
+		j = ringtoneFind(finds[i][0]);
+		if(j < 0 ? finds[i][1] != 0 : finds[i][1] == 0 || strcmp(ringtones[j].title, finds[i][1]) != 0)
+		{
+			printf("  ringtoneFind(\"%s\") gave %d\n", finds[i][0], j);
+			badFinds++;
+		}
+	}
+
+	printf("%d ringtones, %ld bytes, %d notes\n", BUILTIN+CORPUS, bytes, notesNew);
+	printf("  three pass  %8.1f M notes/s\n", rateOld/1e6);
+	printf("  one pass    %8.1f M notes/s  (%.2fx)\n", rateNew/1e6, rateNew/rateOld);
+	printf("  parser state %zu bytes, the old parser copied the text into %zu bytes\n",
+			sizeof(RTTTL_PARSER), sizeof(name)+sizeof(defaults)+bytes/(BUILTIN+CORPUS)+2);
+	printf("Same notes: %s\n", bad ? "FAILED" : "ok");
+
+	printf("Conformance: %d cases, %d ringtones, %ld bytes, %d notes\n", CASES, CONFORM, conformBytes, notesConform);
+	printf("  one pass    %8.1f M notes/s, %.1f MB/s\n", rateConform/1e6,
+			conformBytes / ((double)notesConform / rateConform) / 1e6);
+	printf("Cases: %s\n", badCases ? "FAILED" : "ok");
+	printf("Conformance corpus: %s (%d wrong)\n", badConform ? "FAILED" : "ok", badConform);
+	printf("Ringtone lookup (%d names): %s\n", FINDS, badFinds ? "FAILED" : "ok");
+
+	return bad != 0 || badCases != 0 || badConform != 0 || badFinds != 0;
+}
@@ -0,0 +1,29 @@
+/*
+ *	@author		abradbury
+ *
+ *	Host stand-in, see lpc_types.h.
+ */
+
+#ifndef __SIM_LPC17XX_H
+#define __SIM_LPC17XX_H
+
+#include "lpc_types.h"
+
+typedef enum {TIMER0_IRQn = 1, DMA_IRQn = 26} IRQn_Type;
+
+typedef struct {
+	volatile uint32_t	IR, TCR, TC, PR, PC, MCR, MR0, MR1, MR2, MR3;
+} LPC_TIM_TypeDef;
+
+typedef struct {
+	int					unused;
+} LPC_UART_TypeDef;
+
+extern LPC_TIM_TypeDef	simTimer0;
+#define LPC_TIM0		(&simTimer0)
+#define LPC_UART0		((LPC_UART_TypeDef *) 0)
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void __WFI(void);
+#endif
@@ -0,0 +1,16 @@
+/*
+ *	@author		abradbury
+ *
+ *	Host stand-in, see lpc_types.h.
+ */
+
+#ifndef __SIM_DEBUG_FRMWRK_H
+#define __SIM_DEBUG_FRMWRK_H
+
+#include "LPC17xx.h"
+
+void UARTPutChar(LPC_UART_TypeDef *uart, uint8_t ch);
+void UARTPuts(LPC_UART_TypeDef *uart, const void *str);
+void UARTPutDec(LPC_UART_TypeDef *uart, uint8_t num);
+void UARTPutDec16(LPC_UART_TypeDef *uart, uint16_t num);
+#endif
@@ -0,0 +1,35 @@
+/*
+ *	@author		abradbury
+ *
+ *	Host stand-in, see lpc_types.h.
+ */
+
+#ifndef __SIM_LPC17XX_TIMER_H
+#define __SIM_LPC17XX_TIMER_H
+
+#include "LPC17xx.h"
+
+#define TIM_TIMER_MODE			0
+#define TIM_PRESCALE_TICKVAL	0
+#define TIM_PRESCALE_USVAL		1
+#define TIM_EXTMATCH_NOTHING	0
+
+typedef enum {TIM_MR0_INT, TIM_MR1_INT, TIM_MR2_INT, TIM_MR3_INT} TIM_INT_TYPE;
+
+typedef struct {
+	uint8_t		PrescaleOption;
+	uint32_t	PrescaleValue;
+} TIM_TIMERCFG_Type;
+
+typedef struct {
+	uint8_t		MatchChannel, IntOnMatch, StopOnMatch, ResetOnMatch, ExtMatchOutputType;
+	uint32_t	MatchValue;
+} TIM_MATCHCFG_Type;
+
+void TIM_Init(LPC_TIM_TypeDef *timer, uint8_t mode, void *config);
+void TIM_ConfigMatch(LPC_TIM_TypeDef *timer, TIM_MATCHCFG_Type *match);
+void TIM_Cmd(LPC_TIM_TypeDef *timer, FunctionalState state);
+void TIM_ResetCounter(LPC_TIM_TypeDef *timer);
+FlagStatus TIM_GetIntStatus(LPC_TIM_TypeDef *timer, TIM_INT_TYPE flag);
+void TIM_ClearIntPending(LPC_TIM_TypeDef *timer, TIM_INT_TYPE flag);
+#endif
@@ -0,0 +1,16 @@
+/*
+ *	@author		abradbury
+ *
+ *	Host stand-ins for the few parts of the NXP and CMSIS headers that the
+ *	audio code uses, so bench/audio_bench.c can build music.c, morse.c and
+ *	seq.c unchanged. The functions are in bench/audio_bench.c.
+ */
+
+#ifndef __SIM_LPC_TYPES_H
+#define __SIM_LPC_TYPES_H
+
+#include <stdint.h>
+
+typedef enum {RESET = 0, SET = !RESET} FlagStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+#endif
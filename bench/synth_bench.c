@@ -0,0 +1,172 @@
+/*
+ *	@author		abradbury
+ *
+ *	synth_bench.c is a host (Linux) benchmark for synth.c. It checks the
+ *	wavetable against sin() and the frequency of every note against the
+ *	equal tempered one, then times synthRender() a DMA block at a time with
+ *	0 to SYNTH_VOICES voices playing. For each it prints the time per
+ *	sample and how many times faster than the SYNTH_RATE the DAC takes
+ *	them that is, against a straightforward mixer that adds the voices up
+ *	sample by sample and clamps with compares, which it checks gives the
+ *	same samples. Last it times four voices with the piano envelope and a
+ *	different wave each.
+ *
+ *	The host is many times faster than the board's 100 MHz Cortex-M3, so the
+ *	multiple shows the cost per sample, not the board's headroom; on the
+ *	board each voice is a load and a multiply-accumulate per sample, and
+ *	the mix a shift, an SSAT and a store.
+ *
+ *	Build and run with 'make bench' from the top directory.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "synth.h"
+
+#define BLOCK		128		// Samples per DMA half buffer, as DAC_BLOCK in memmap.h
+#define BLOCKS		1000
+#define REPS		50
+
+static uint32_t		buffer[BLOCK], plainBuffer[BLOCK];
+
+static uint32_t		phases[SYNTH_VOICES], steps[SYNTH_VOICES];
+static int32_t		gains[SYNTH_VOICES];
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+/*
+ *	plainRender() mixes the voices a sample at a time, with the voices set
+ *	up by plainVoices().
+ */
+static void plainRender(uint32_t *out, int n)
+{
+	int32_t sum;
+	int i, v;
+	for(i=0; i<n; i++)
+	{
+		sum = 0;
+		for(v=0; v<SYNTH_VOICES; v++)
+		{
+			if(steps[v] == 0) continue;
+			sum += synthWaves[SYNTH_SINE][phases[v] >> (32-SYNTH_BITS)] * gains[v];
+			phases[v] += steps[v];
+		}
+		sum >>= SYNTH_GAIN_BITS;
+		if(sum > SYNTH_AMP) sum = SYNTH_AMP;
+		if(sum < -SYNTH_MID) sum = -SYNTH_MID;
+		out[i] = (uint32_t)(SYNTH_MID + sum) << 6;
+	}
+}
+
+/*
+ *	plainVoices() plays the first n voices of a chord through both mixers,
+ *	loud enough that the mix clips. The organ envelope is used, which is
+ *	at full level from the first tick to the note off, and a block is
+ *	rendered first so the release of the last chord is over.
+ */
+static void plainVoices(int n)
+{
+	static const int chord[SYNTH_VOICES] = {10, 14, 17, 22};	// A4 C#5 E5 A5
+	int v;
+	for(v=0; v<SYNTH_VOICES; v++)
+	{
+		synthEnvelope(v, SYNTH_ORGAN);
+		synthShape(v, SYNTH_SINE);
+		synthNote(v, v < n ? chord[v] : 0);
+		synthGain(v, SYNTH_GAIN/2);
+	}
+	synthRender(buffer, BLOCK);
+	for(v=0; v<SYNTH_VOICES; v++)
+	{
+		phases[v] = synthVoices[v].phase;
+		steps[v] = v < n ? synthSteps[chord[v]] : 0;
+		gains[v] = SYNTH_GAIN/2;
+	}
+}
+
+/*
+ *	run() times one of the mixers, keeping the fastest of REPS runs.
+ *
+ *	@return				ns per sample
+ */
+static double run(void (*render)(uint32_t*, int), uint32_t *out)
+{
+	double t, best = 1e30;
+	uint32_t sum = 0;
+	int i, r;
+	for(r=0; r<REPS; r++)
+	{
+		t = now();
+		for(i=0; i<BLOCKS; i++)
+		{
+			render(out, BLOCK);
+			sum += out[i % BLOCK];
+		}
+		t = now() - t;
+		if(t < best) best = t;
+	}
+	if(sum == 1) printf(" ");			// Keep the work
+	return best / (BLOCKS*(double)BLOCK);
+}
+
+int main(void)
+{
+	double t, tp, hz, want, err, maxErr = 0, waveErr = 0;
+	int i, n, bad = 0;
+
+	for(i=0; i<SYNTH_WAVE; i++)
+	{
+		err = fabs(synthWaves[SYNTH_SINE][i] - SYNTH_AMP*sin(2*M_PI*i/SYNTH_WAVE));
+		if(err > waveErr) waveErr = err;
+	}
+
+	for(i=1; i<=SYNTH_NOTES; i++)
+	{
+		want = 440.0 * pow(2.0, (i - 10) / 12.0);	// Note 10 is A4
+		hz = (double)synthSteps[i] * SYNTH_RATE / 4294967296.0;
+		err = fabs(hz - want);
+		if(err > maxErr) maxErr = err;
+		if(err > 0.05 * (1 << ((i-1)/12))) bad++;
+	}
+
+	printf("Wavetable: %d samples, worst %.1f of %d from sin()\n", SYNTH_WAVE, waveErr, SYNTH_AMP);
+	printf("Notes: %d, worst %.3f Hz from equal tempered, resolution %.2f uHz\n",
+			SYNTH_NOTES, maxErr, 1e6 * SYNTH_RATE / 4294967296.0);
+	printf("Notes in tune: %s\n", bad ? "FAILED" : "ok");
+
+	printf("ns per sample (x the %d Hz rate):\n", SYNTH_RATE);
+	printf("  voices       by sample             by voice\n");
+	for(n=0; n<=SYNTH_VOICES; n++)
+	{
+		plainVoices(n);
+		for(i=0; i<8; i++)
+		{
+			synthRender(buffer, BLOCK);
+			plainRender(plainBuffer, BLOCK);
+			if(memcmp(buffer, plainBuffer, sizeof(buffer)) != 0) bad++;
+		}
+		tp = run(plainRender, plainBuffer);
+		t = run(synthRender, buffer);
+		printf("  %6d  %6.2f (%6.0fx)      %6.2f (%6.0fx)\n", n, tp, 1e9/tp/SYNTH_RATE, t, 1e9/t/SYNTH_RATE);
+	}
+	printf("Same samples: %s\n", bad ? "FAILED" : "ok");
+
+	// The envelopes are stepped a tick at a time, so should cost next to nothing
+	for(i=0; i<SYNTH_VOICES; i++)
+	{
+		synthEnvelope(i, SYNTH_PIANO);
+		synthShape(i, i % SYNTH_SHAPES);
+		synthNote(i, 10 + 4*i);
+	}
+	t = run(synthRender, buffer);
+	printf("  %d voices, piano envelope, one of each wave: %.2f ns per sample\n", SYNTH_VOICES, t);
+
+	return bad != 0;
+}
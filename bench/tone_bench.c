@@ -0,0 +1,198 @@
+/*
+ *	@author		abradbury
+ *
+ *	tone_bench.c is a host (Linux) benchmark for the note tables in tone.c
+ *	and synth.c. It compiles every note of the menu's ringtones (see
+ *	ringtones.c) both ways:
+ *
+ *	- float: music() and duration(), as music.c had them, then the
+ *	  synthesiser's phase step worked out from the frequency,
+ *	- table: toneNote() and toneTicks(), as music.c does now, and the step
+ *	  from synthSteps[],
+ *
+ *	checks that they give the same length for every note and frequencies
+ *	within 0.01 Hz, and prints the time stamp counter cycles per note for
+ *	each.
+ *
+ *	It is built with -O0, as the firmware is. The host has a hardware FPU,
+ *	so the float figures are far better than the board's: with -msoft-float
+ *	each float divide on the Cortex-M3 is a library call of some tens of
+ *	cycles. The comparison is of the work left, not of the board's times.
+ *
+ *	Build and run with 'make bench' from the top directory.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "rtttl.h"
+#include "ringtones.h"
+#include "tone.h"
+#include "synth.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define MAXNOTES	1024
+#define REPS		2000
+
+typedef struct {
+	int		pitch, octave, dur, dot, beat, bpm;
+} NOTE;
+
+#define BUILTIN		RINGTONES
+
+static NOTE			notes[MAXNOTES];
+static int			count;
+static uint32_t		floatEvents[MAXNOTES][2], tableEvents[MAXNOTES][2];
+static int			ddur, dbpm;
+
+static uint64_t now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000000ull + ts.tv_nsec;
+#endif
+}
+
+/*
+ *	music(), duration() and the timeout from sine(), as they were.
+ */
+static const char	notePitches[12] = {'c','j','d','k','e','f','m','g','n','a','h','b'};
+
+static float music(char note, int octave)
+{
+	float value = 0;
+	switch(note)
+	{
+		case 'c': value = 261.63; break;
+		case 'j': value = 277.18; break;
+		case 'd': value = 293.66; break;
+		case 'k': value = 311.13; break;
+		case 'e': value = 329.63; break;
+		case 'f': value = 349.23; break;
+		case 'm': value = 369.99; break;
+		case 'g': value = 392.00; break;
+		case 'n': value = 415.30; break;
+		case 'a': value = 440.00; break;
+		case 'h': value = 466.16; break;
+		case 'b': value = 493.88; break;
+		default: value = 0.00; break;
+	}
+	if(octave == 5) value = value * 2;
+	else if(octave == 6) value = value * 4;
+	else if(octave == 7) value = value * 8;
+	return value;
+}
+
+static float duration(int dur, int dot)
+{
+	float blockTime = 1.0/(((float)dbpm)/60.0);
+	float value = ((float)ddur/(float)dur)*blockTime;
+	if(dot == 1) value = value*1.5;
+	if(value > 65.535) value = 65.535;
+	return value*1000;
+}
+
+static void compileFloat(void)
+{
+	float note;
+	int i;
+	for(i=0; i<count; i++)
+	{
+		ddur = notes[i].beat;
+		dbpm = notes[i].bpm;
+		note = notes[i].pitch ? music(notePitches[notes[i].pitch-1], notes[i].octave) : 0;
+		floatEvents[i][0] = note*(4294967296.0f/SYNTH_RATE);
+		floatEvents[i][1] = duration(notes[i].dur, notes[i].dot);
+	}
+}
+
+static void compileTable(void)
+{
+	int i;
+	for(i=0; i<count; i++)
+	{
+		tableEvents[i][0] = synthSteps[toneNote(notes[i].pitch, notes[i].octave)];
+		tableEvents[i][1] = toneTicks(notes[i].dur, notes[i].dot, notes[i].beat, notes[i].bpm);
+	}
+}
+
+static void note(RTTTL_PARSER *p, int pitch, int octave, int dur, int dot)
+{
+	if(count < MAXNOTES)
+	{
+		notes[count].pitch = pitch;
+		notes[count].octave = octave;
+		notes[count].dur = dur;
+		notes[count].dot = dot;
+		notes[count].beat = p->dur;
+		notes[count].bpm = p->bpm;
+		count++;
+	}
+}
+
+/*
+ *	run() times one way of compiling the notes, keeping the fastest of REPS.
+ *
+ *	@return				Cycles per note
+ */
+static double run(void (*compile)(void))
+{
+	uint64_t t, best = ~0ull;
+	int r;
+	for(r=0; r<REPS; r++)
+	{
+		t = now();
+		compile();
+		t = now() - t;
+		if(t < best) best = t;
+	}
+	return (double)best / count;
+}
+
+int main(void)
+{
+	RTTTL_PARSER p;
+	double tf, tt;
+	int i, bad = 0;
+
+	for(i=0; i<BUILTIN; i++)
+	{
+		rtttlInit(&p, note, 0);
+		rtttlFeed(&p, ringtones[i].rtttl, strlen(ringtones[i].rtttl));
+		rtttlEnd(&p);
+	}
+
+	compileFloat();
+	compileTable();
+	for(i=0; i<count; i++)
+	{
+		double hz = (double)floatEvents[i][0] * SYNTH_RATE / 4294967296.0;
+		double error = hz - (double)tableEvents[i][0] * SYNTH_RATE / 4294967296.0;
+		if(error < -0.01 || error > 0.01 || floatEvents[i][1] != tableEvents[i][1])
+		{
+			printf("  note %d: float %u %u, table %u %u\n", i, floatEvents[i][0], floatEvents[i][1],
+					tableEvents[i][0], tableEvents[i][1]);
+			bad++;
+		}
+	}
+
+	tf = run(compileFloat);
+	tt = run(compileTable);
+
+#if defined(__x86_64__) || defined(__i386__)
+	printf("%d notes, TSC cycles per note (host FPU, see above):\n", count);
+#else
+	printf("%d notes, ns per note (host FPU, see above):\n", count);
+#endif
+	printf("  float  %8.1f\n", tf);
+	printf("  table  %8.1f  (%.1fx)\n", tt, tf/tt);
+	printf("Same notes: %s\n", bad ? "FAILED" : "ok");
+
+	return bad != 0;
+}
@@ -18,15 +18,23 @@
 #include "debug_frmwrk.h"
 #include "sevenseg.h"
 #include "mysys.h"
+#include "lookup.h"
+#include "arena.h"
+#include "memmap.h"
+#include "stack.h"
 
 #define CAN		LPC_CAN2
 #define IAM		0x14008440			// I am online from bench 07 to 0
+#define BUFSIZE	CANQ_ENTRIES		// The number of messages the buffer can hold
 
 CAN_MSG_Type		SMsg;			// Stores the message to be sent
 CAN_MSG_Type		RMsg;			// Stores the message to be received
-CAN_MSG_Type 		buffer[255];	// Buffer for storing messages, assume initialised to 0/empty
-int					bufMsgs = 0;	// Holds the number of messages buffered
+// The buffer is kept in AHB SRAM bank 1, away from the CPU's main SRAM (see memmap.h)
+CAN_MSG_Type * const	bufMsg = (CAN_MSG_Type *) CANQ_ADDR;	// Buffered messages
+typedef char		bufSlotCheck[sizeof(CAN_MSG_Type) == CANQ_SLOT ? 1 : -1];	// Fails to compile if memmap.h is wrong
+volatile int		bufMsgs = 0;	// Holds the number of messages buffered
 int					decMsgs = 0;	// Holds the number of messages deciphered
+int					lostMsgs = 0;	// Holds the number of messages lost to a full buffer
 int					textCount = 0;	// A counter for the number of text blocks received
 uint32_t 			whoID = 0x14008440;	// Message ID template for whoIs response
 uint8_t 			whoTarget;		// Holds the target address for the reply
@@ -97,14 +105,14 @@ void send_CAN(uint32_t ident, uint8_t tpe, uint8_t datA, uint8_t datB)
 	SMsg.dataA[0] = SMsg.dataA[1] = SMsg.dataA[2] = SMsg.dataA[3] = datA;
 	SMsg.dataB[0] = SMsg.dataB[1] = SMsg.dataB[2] = SMsg.dataB[3] = datB;
 	
-	if(CAN_GET_CMD(RMsg.id) == CMD_IAM)
+	if(CAN_GET_CMD(ident) == CMD_IAM)
 	{
 		CAN_SendMsg(CAN, &SMsg);	// Do not decipher
 		//write_usb_serial_blocking("I am\n\r",6);
 	}
 	else
 	{
-		if(CAN_SendMsg(CAN, &SMsg) == SUCCESS) decipher(SMsg,'s');
+		if(CAN_SendMsg(CAN, &SMsg) == SUCCESS) decipher(&SMsg,'s');
 		else write_usb_serial_blocking("Message not sent\n\r",18);
 	}
 }
@@ -115,34 +123,55 @@ void send_CAN(uint32_t ident, uint8_t tpe, uint8_t datA, uint8_t datB)
  */
 void return_CAN()
 {
-	if(CAN_ReceiveMsg (CAN, &RMsg) == SUCCESS) decipher(RMsg,'r');
+	if(CAN_ReceiveMsg (CAN, &RMsg) == SUCCESS) decipher(&RMsg,'r');
 	else write_usb_serial_blocking("Message not recieved\n\r",23);		
 }
 
 /*	
  *	CAN_IRQHandler() is triggered when a message is received from the CAN 
- *	network. The message is received from the receive buffer and stored in 
- *	the buffer. The counter is then incremented and the 4 are LED's turned 
- *	on to indicate a received message. 
+ *	network. The message is read from the CAN controller straight into the 
+ *	next free place in the buffer, so it is not copied again. The counter is 
+ *	then incremented and the 4 are LED's turned on to indicate a received 
+ *	message. 
  *
  *	If a received message is a who is online command, the whois() method
- *	is called.
+ *	is called, and a call ID reply is stored in the lookup cache straight 
+ *	away by lookupStore(), so it is matched to its lookup as it arrives. 
+ *	Messages that are part of an acknowledged text transfer are passed 
+ *	through rx_flow() first, which decides whether they are kept, and 
+ *	refuses their blocks while the buffer is full.
  *	
  *	To ensure that messages that are sent rapidly over the network can be 
  *	received reliably, every message is buffered, not just text and RTTTL 
- *	messages.
+ *	messages. If the buffer is full the message is read into RMsg, to free 
+ *	the controller for the next one, and is counted as lost.
  */
 void CAN_IRQHandler()
 {	
-	CAN_ReceiveMsg (CAN, &RMsg);	
+	CAN_MSG_Type *slot = (bufMsgs < BUFSIZE) ? &bufMsg[bufMsgs] : &RMsg;
 	
-	if(CAN_GET_CMD(RMsg.id) == CMD_WHOIS) whois(RMsg);
-
-	buffer[bufMsgs] = RMsg;
-	bufMsgs++;
+	STACK_BEGIN(STACK_CAN);
+	CAN_ReceiveMsg (CAN, slot);	
+	
+	if(CAN_GET_CMD(slot->id) == CMD_WHOIS) whois(slot);
+	if(CAN_GET_CMD(slot->id) == CMD_CALLID) lookupStore(slot);
 	
-	GPIO_SetDir(1, 0x00B40000, 1);
-	GPIO_SetValue(1, 0x00B40000);
+	if(!rx_flow(slot))
+	{
+		// Refused by the flow control in text.c, the slot is used again
+	}
+	else if(slot == &RMsg)
+	{
+		lostMsgs++;
+	}
+	else
+	{
+		bufMsgs++;
+		
+		GPIO_SetDir(1, 0x00B40000, 1);
+		GPIO_SetValue(1, 0x00B40000);
+	}
+	STACK_END(STACK_CAN);
 }
 
 /*	
@@ -154,11 +183,11 @@ void CAN_IRQHandler()
  *	@param	msg			The who is message received.
  *	@return	whoID		The ID of the reply message.
  */
-uint32_t whois(CAN_MSG_Type msg)
+uint32_t whois(const CAN_MSG_Type *msg)
 {	
 	TIM_Cmd(LPC_TIM1, ENABLE);
 	
-	whoTarget = CAN_GET_SOURCE_ADD(msg.id);
+	whoTarget = CAN_GET_SOURCE_ADD(msg->id);
 	whoID = whoID | whoTarget;
 	return whoID;
 }
@@ -173,7 +202,7 @@ uint32_t whois(CAN_MSG_Type msg)
  *	@param	t			A flag indicating is a message is being received
  *						or sent. 'r' if receiving, 's' if sending.
  */
-void pre(CAN_MSG_Type msg, char t)
+void pre(const CAN_MSG_Type *msg, char t)
 {
 	if(t == 'r')
 	{
@@ -201,9 +230,9 @@ void pre(CAN_MSG_Type msg, char t)
  *	@param	t			A flag indicating is a message is being received
  *						or sent. 'r' if receiving, 's' if sending.
  */
-void decipher(CAN_MSG_Type msg, char t)
+void decipher(const CAN_MSG_Type *msg, char t)
 {
-	switch(CAN_GET_CMD(msg.id))
+	switch(CAN_GET_CMD(msg->id))
 	{
 		case CMD_WHOIS:
 			if(t == 'r')	 
@@ -223,7 +252,7 @@ void decipher(CAN_MSG_Type msg, char t)
 		case CMD_CALLID:
 			pre(msg, t);
 			write_usb_serial_blocking("Name Lookup data",16);
-			post(msg);
+			post(msg);			// Already stored by lookupStore() in the CAN interrupt
 			break;
 		case CMD_VOICE:
 			pre(msg, t);
@@ -232,6 +261,7 @@ void decipher(CAN_MSG_Type msg, char t)
 		case CMD_CHECKSUM:
 			pre(msg, t);
 			write_usb_serial_blocking("Checksum",8);
+			check_text(msg);	// Check the text received so far
 			post(msg);
 			break;
 		case CMD_DIALTONES:
@@ -249,12 +279,13 @@ void decipher(CAN_MSG_Type msg, char t)
 		case CMD_TEXTBLOCK:
 			textCount++;
 			rx_text(msg);
-			//UARTPuts((LPC_UART_TypeDef *)LPC_UART0, msg.dataA);	// Don't need dataB
+			//UARTPuts((LPC_UART_TypeDef *)LPC_UART0, msg->dataA);	// Don't need dataB
 			break;
 		case CMD_CLEARCALL:	
 			pre(msg, t);
 			write_usb_serial_blocking("Clear call ID",13);
 			post(msg);
+			lookupClear(msg);
 			break;
 		case CMD_IAM:
 			pre(msg, t);
@@ -288,7 +319,7 @@ void decipher(CAN_MSG_Type msg, char t)
 		default:
 			pre(msg, t);
 			write_usb_serial_blocking("Unknown command (",17);
-			UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, CAN_GET_CMD(msg.id));
+			UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, CAN_GET_CMD(msg->id));
 			write_usb_serial_blocking(")",1);
 			post(msg);
 			break;
@@ -302,22 +333,22 @@ void decipher(CAN_MSG_Type msg, char t)
  *	
  *	@param	msg			The message received.
  */
-void post (CAN_MSG_Type msg)
+void post (const CAN_MSG_Type *msg)
 {
 	write_usb_serial_blocking(" from station ",14);
-	UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, CAN_GET_SOURCE_ADD(msg.id));
-	seg_digit(CAN_GET_SOURCE_ADD(msg.id),1);
+	UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, CAN_GET_SOURCE_ADD(msg->id));
+	seg_digit(CAN_GET_SOURCE_ADD(msg->id),1);
 	write_usb_serial_blocking(" to station ",12);
-	UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, CAN_GET_TARGET_ADD(msg.id));
-	seg_digit(CAN_GET_TARGET_ADD(msg.id),2);
+	UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, CAN_GET_TARGET_ADD(msg->id));
+	seg_digit(CAN_GET_TARGET_ADD(msg->id),2);
 	write_usb_serial_blocking("\n\r",4);
 
 	write_usb_serial_blocking("Message id: \t",13);
-	UARTPutHex32((LPC_UART_TypeDef *)LPC_UART0, msg.id);
+	UARTPutHex32((LPC_UART_TypeDef *)LPC_UART0, msg->id);
 	write_usb_serial_blocking("\t",2);
 	
 	write_usb_serial_blocking("Data: \t",8);
-	UARTPuts((LPC_UART_TypeDef *)LPC_UART0, msg.dataA);
+	UARTPuts((LPC_UART_TypeDef *)LPC_UART0, msg->dataA);
 	write_usb_serial_blocking("\n\r",4);
 	write_usb_serial_blocking("\n\r",4);	
 }
@@ -331,7 +362,7 @@ void post (CAN_MSG_Type msg)
 void TIMER1_IRQHandler()
 {
 	TIM_ClearIntPending(LPC_TIM1, TIM_MR1_INT);
-	send_CAN(whois(who), DATA_FRAME, 0x00, 0x00);
+	send_CAN(whois(&who), DATA_FRAME, 0x00, 0x00);
 }
 
 /*	
@@ -378,7 +409,8 @@ void init_CAN()
 	NVIC_EnableIRQ(CAN_IRQn);					// CPU CAN Interrupt Enable
 	NVIC_EnableIRQ(TIMER1_IRQn);				// CPU Timer Interrupt Enable	
 
-	MSYS_Init ((void*) 0x2007C000, 0x4000);
+	MSYS_Init ((void*) HEAP_ADDR, HEAP_SIZE);
+	arenaInit(&decodeArena, MSYS_Alloc(DECODE_ARENA), DECODE_ARENA);
 
 	write_usb_serial_blocking("CAN initialised\n\r",19);
 }
@@ -388,15 +420,21 @@ void init_CAN()
  *	While the number of deciphered messages isn't equal to the number of 
  *	messages currently in the buffer, the buffered messages are deciphered.
  *	Then, when all the buffered messages have been decoded, the counters are 
- *	reset and then LEDs (turned on when a message is received) are turned off.
+ *	reset and then LEDs (turned on when a message is received) are turned off. 
+ *	A sender waiting on a full buffer is then told there is space again.
+ *	
+ *	Each message is deciphered where it lies in the buffer. The slot is lent 
+ *	to decipher() and everything it calls, and is only free to be used 
+ *	again once decMsgs has moved past it.
  */
 void receiveBufferHandler()
 {
+	STACK_BEGIN(STACK_INBOX);
 	while(decMsgs != bufMsgs)
 	{
 		if(bufMsgs > 0)
 		{
-			decipher(buffer[decMsgs],'r');			
+			decipher(&bufMsg[decMsgs],'r');			
 			decMsgs++;
 		}
 	}
@@ -406,5 +444,18 @@ void receiveBufferHandler()
 		decMsgs = 0;
 
 		GPIO_ClearValue(1, 0x00B40000);
+		rx_window();
 	}
+	STACK_END(STACK_INBOX);
+}
+
+/*	
+ *	bufferFree() gives the number of messages that can still be buffered 
+ *	before the buffer is next emptied.
+ *	
+ *	@return				The number of free places in the buffer
+ */
+int bufferFree()
+{
+	return BUFSIZE - bufMsgs;
 }
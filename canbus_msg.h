@@ -3,7 +3,8 @@
  * 
  *	canbus_msg.h contains macros used for the decoding and composition of messages from the 
  *	CAN network courtesy of P. Cooper. The file is mostly unchanged from the original.
- *	Modifications include adding the bounce command macro and correcting lines 64-66.
+ *	Modifications include adding the bounce command macro, correcting lines 64-66 and 
+ *	adding the extended and acknowledged text transfer definitions.
  */
 
 // canbus_msg.h
@@ -39,15 +40,41 @@
 								// eight bit count of block number, has to be sent after
 								// an CMD_STEXT, block size will tell the receiving end
 								// how many packets to expect
+								// Extended transfers (more than 255 blocks) are sent as
+								// segments, each with its own CMD_STEXT carrying the 32 bit
+								// total length in dataA and the segment number in dataB[0..1],
+								// the block count in the header is then per segment
 #define	CMD_ETEXT		0x0a	// End of text block, so the remote end know's
 #define	CMD_ERROR		0x0b	// Error message send down the bus
 #define	CMD_TESTSOUND	0x0c	// send a test sound string over the bus :-)
 #define	CMD_BOUNCE		0x0d	// bounce
+#define	CMD_TEXTACK		0x0e	// Acknowledge text blocks, sent by the receiver of an
+								// acknowledged transfer. dataA holds the number of blocks
+								// received in order so far and dataB[0] the number of
+								// further blocks the receiver can take (the window)
 
 
+// Extended text transfer
+#define	TEXT_SEG_BLOCKS		255		// Maximum number of blocks in one segment
+#define	TEXT_SEG_BYTES		(TEXT_SEG_BLOCKS*8)	// Payload bytes carried by one full segment
+
+// Acknowledged text transfer, requested by the sender in dataB[2] of CMD_STEXT
+#define	TEXT_FLAG_ACK		0x01	// Receiver should answer with CMD_TEXTACK
+#define	TEXT_WINDOW			16		// Largest window a receiver will grant
+#define	TEXT_ACK_PROBE		0x01	// In dataB[1] of CMD_TEXTACK sent by the sender, asking a receiver
+									// that granted a window of 0 for its window again
+#define	TEXT_ACK_NOTES		0x02	// In dataB[1] of CMD_TEXTACK sent by the receiver, it can decode
+									// TEXT_FORMAT_NOTES, so ringtones may be sent to it that way
+
+// Payload format, sent by the sender in dataB[3] of CMD_STEXT
+#define	TEXT_FORMAT_TEXT	0x00	// Text or RTTTL string
+#define	TEXT_FORMAT_NOTES	0x01	// Binary note stream (see rtttlEncode() in music.c),
+									// always sent with its exact length in dataA
+
 // Predefined network addresses used on the can bus
 #define	CANADD_DNS		0x01		// six bit address to the DNS machine
 #define CANADD_GW		0x01		// six bit address to gateway machine
+#define	CANADD_SELF		0x11		// six bit address of this station, bench 07
 
 // Pre defined Bit Masks
 #define	CAN2BIT			0x00000003			// 2 bit mask
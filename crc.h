@@ -0,0 +1,7 @@
+/*	
+ *	@author		abradbury
+ */
+
+#include "stdint.h"
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t len);
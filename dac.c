@@ -1,8 +1,15 @@
 /*	
  *	@author		abradbury
  * 
- *	Dac.c contains methods concerned with the DAC. It initialises the DAC, 
- *	initialises the sine wave for note output and then plays notes.
+ *	Dac.c contains methods concerned with the DAC. It initialises the DAC 
+ *	and the DMA channel that feeds it, and keeps the DMA supplied with 
+ *	samples from the synthesiser (see synth.c) while a sound is playing.
+ *	
+ *	The DAC takes a sample every SYNTH_RATE'th of a second. The DMA channel 
+ *	sends it samples from two buffers of DAC_BLOCK samples in turn, linked 
+ *	to each other so it never stops. When the DMA finishes a buffer it 
+ *	interrupts, and the buffer is filled with the next block while the 
+ *	other one is sent.
  */
 
 #include "lpc17xx_dac.h"
@@ -10,25 +17,23 @@
 #include "lpc17xx_gpdma.h"
 #include "debug_frmwrk.h"
 #include "dac.h"
-#include "math.h"
 #include "keypad.h"
 #include "serial.h"
-
-#define CALFREQ		25	// Calibration frequency
+#include "memmap.h"
+#include "synth.h"
 
 DAC_CONVERTER_CFG_Type	Dac;			// Struct used to initialise the DAC
-GPDMA_LLI_Type 			DMA_LinkList;	// DMA Linked list structure for GPDMA
 GPDMA_Channel_CFG_Type	DMA_Chan;		// GPDMA channel configuration structure
 
-// 16 samples from sin0 to sin90 in degrees
-uint32_t	sineSamples[16] = {0, 1045, 2079, 3090, 4067, 5000, 5877, 6691, 7431, 8090, 8660, 9135, 9510, 9781, 9945, 10000};
-uint32_t 	sineValues[60];
-
+// Read by the DMA controller, so kept in AHB SRAM bank 1 (see memmap.h)
+GPDMA_LLI_Type * const	DMA_LinkList = (GPDMA_LLI_Type *) DAC_LLI_ADDR;	// One DMA linked list entry per buffer
+uint32_t * const		dacBuffer = (uint32_t *) DAC_BUF_ADDR;			// The two buffers, one after the other
 
 /*	
  *	init_DAC() initialises the Digital-to-Analogue converter. It sets up
  *	the pins, enables the time out counter, double buffer and DMA, sets 
- *	the bias to performance and sets the DMA timeout to 7100.
+ *	the bias to performance and sets the DMA timeout for SYNTH_RATE samples 
+ *	a second.
  */
 void init_DAC()
 {
@@ -47,7 +52,7 @@ void init_DAC()
 	
 	DAC_SetBias(LPC_DAC,0);
 	DAC_ConfigDAConverterControl(LPC_DAC, &Dac);
-	DAC_SetDMATimeOut(LPC_DAC, 7100);
+	DAC_SetDMATimeOut(LPC_DAC, CALFREQ*1000000/SYNTH_RATE);
 	DAC_Init(LPC_DAC);
 	
 	write_usb_serial_blocking("DAC Initialised\n\r",18);
@@ -65,72 +70,75 @@ void feed_DAC(uint32_t data)
 }
 
 /*	
- *	sineSetup() prepares the values that are to be used to produce the 
- *	sine wave outputted from the DAC. It uses basic values from the 
- *	sineSamples array. The values are increased by 512 and shifted 
- *	left by 6 bits so the peak-to-peak values are in the DAC's range 
- *	of 0-1023. It then sets up a linked list so that the DMA can continuously
- *	send the values to the DAC, producing a continuous wave whilst required.
- *	Finally it sets up the DMA to send this data.
+ *	dacSetup() sets up the DMA channel to send the two buffers to the DAC 
+ *	in turn, interrupting at the end of each. The channel is left off 
+ *	until dacStart().
  */
-void sineSetup()
-{		
-	uint32_t 	i;
+void dacSetup()
+{
+	int i;
 	
-	for(i=0;i<60;i++)
+	for(i=0; i<2; i++)
 	{
-		if(i<=15)
-		{
-			sineValues[i] = 512 + 512*sineSamples[i]/10000;
-			if(i==15) sineValues[i]= 1023;
-		}
-		else if(i<=30)
-		{
-			sineValues[i] = 512 + 512*sineSamples[30-i]/10000;
-		}
-		else if(i<=45)
-		{
-			sineValues[i] = 512 - 512*sineSamples[i-30]/10000;
-		}
-		else
-		{
-			sineValues[i] = 512 - 512*sineSamples[60-i]/10000;
-		}
-		sineValues[i] = (sineValues[i]<<6);
+		DMA_LinkList[i].SrcAddr = (uint32_t)&dacBuffer[i*DAC_BLOCK];		// Source address
+		DMA_LinkList[i].DstAddr = (uint32_t)&(LPC_DAC->DACR);			// Destination address
+		DMA_LinkList[i].NextLLI = (uint32_t)&DMA_LinkList[1-i];		// The other buffer next
+		DMA_LinkList[i].Control = 1u<<31 | 1<<26 | 2<<21 | 2<<18 | DAC_BLOCK;	// Interrupt at the end
 	}
 	
-	DMA_LinkList.SrcAddr = (uint32_t)sineValues;		// Source address
-	DMA_LinkList.DstAddr = (uint32_t)&(LPC_DAC->DACR);	// Destination address
-	DMA_LinkList.NextLLI = (uint32_t)&DMA_LinkList;		// Next LLI address. If none, set to 0
-	DMA_LinkList.Control = 1<<26 | 2<<21 | 2<<18 | 60;	// DMACCxControl register
-	
 	GPDMA_Init();		// Initialise the General Purpose DMA controller
  
 	DMA_Chan.ChannelNum 	= 0;						// Channel 0  
-	DMA_Chan.TransferSize 	= 60;						// Length/size of transfer
+	DMA_Chan.TransferSize 	= DAC_BLOCK;				// Length/size of transfer
 	DMA_Chan.TransferWidth 	= 0;						// Used for M2M only
-	DMA_Chan.SrcMemAddr 	= (uint32_t)(sineValues);	// The sine array in memory
+	DMA_Chan.SrcMemAddr 	= (uint32_t)dacBuffer;		// The first buffer
 	DMA_Chan.DstMemAddr 	= 0;						// Not needed as dest is not mem
 	DMA_Chan.TransferType 	= GPDMA_TRANSFERTYPE_M2P;	// Memory to peripheral
 	DMA_Chan.SrcConn		= 0;						// 0 as is memory
 	DMA_Chan.DstConn 		= GPDMA_CONN_DAC;			// DAC
-	DMA_Chan.DMALLI 		= (uint32_t)&DMA_LinkList;	// Link list structure
+	DMA_Chan.DMALLI 		= (uint32_t)&DMA_LinkList[1];	// Then the second
 	GPDMA_Setup(&DMA_Chan);
+	
+	NVIC_EnableIRQ(DMA_IRQn);
 }
 
 /*	
- *	sine() takes a note value and creates a temporary value which
- *	it uses to set the DMA timeout frequency which in turn affects 
- *	the note played.
- *	
- *	@param	note		The note value to be played
+ *	dacStart() fills both buffers and starts the DMA channel sending them 
+ *	to the DAC. The sound played is set with synthNote().
  */
-void sine(float note)
+void dacStart()
 {
-	uint32_t 	tmp;
-	
-	tmp = (CALFREQ*1000000)/(note*60);
-	DAC_SetDMATimeOut(LPC_DAC,tmp);
-	
+	GPDMA_ChannelCmd(0, DISABLE);
+	dacSetup();
+	synthRender(dacBuffer, 2*DAC_BLOCK);
 	GPDMA_ChannelCmd(0, ENABLE);
 }
+
+/*	
+ *	dacStop() stops the DMA channel, so nothing more is sent to the DAC.
+ */
+void dacStop()
+{
+	GPDMA_ChannelCmd(0, DISABLE);
+}
+
+/*	
+ *	DMA_IRQHandler() is called when the DMA has sent a buffer to the DAC, 
+ *	and fills it with the next block of samples while the other is sent. 
+ *	The DMA's source address says which buffer it has moved on to.
+ */
+void DMA_IRQHandler()
+{
+	if(GPDMA_IntGetStatus(GPDMA_STAT_INTTC, 0))
+	{
+		GPDMA_ClearIntPending(GPDMA_STATCLR_INTTC, 0);
+		if(LPC_GPDMACH0->DMACCSrcAddr >= (uint32_t)&dacBuffer[DAC_BLOCK])
+		{
+			synthRender(dacBuffer, DAC_BLOCK);
+		}
+		else
+		{
+			synthRender(&dacBuffer[DAC_BLOCK], DAC_BLOCK);
+		}
+	}
+}
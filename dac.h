@@ -2,7 +2,10 @@
  *	@author		abradbury
  */
 
+#define CALFREQ		25	// Calibration frequency, the peripheral clock in MHz
+
 void init_DAC(void);
 void feed_DAC(uint32_t data);
-void sineSetup();
-void sine(float note);
+void dacSetup();
+void dacStart();
+void dacStop();
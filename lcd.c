@@ -14,7 +14,6 @@
 #define I2C_BATRON_LCD		0x3B
 
 char posi = 0;				// Holds the current position when writing to the LCD
-char lcdBuffer[100];		// Buffer for LCD output, limited to 100 characters
 
 /*	
  *	init_lcd() is used to set the lcd screen using various parameters. These are
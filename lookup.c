@@ -0,0 +1,199 @@
+/*	
+ *	@author		abradbury
+ *	
+ *	Lookup.c caches the answers to number lookups. A lookup (CMD_DNS) is sent 
+ *	to the exchange, which replies with a call ID (CMD_CALLID). The reply is 
+ *	kept for LOOKUP_TTL ms so repeat lookups of the same number can be 
+ *	answered locally, without going to the exchange. An entry is removed 
+ *	early if its call ID is cleared (CMD_CLEARCALL).
+ *	
+ *	The call ID is taken from the reply header. Only replies from the exchange 
+ *	to this station are taken. The exchange answers lookups in the order they 
+ *	are sent, so lookups waiting for a reply are kept in a small queue and 
+ *	each reply is matched to the oldest of them. The station is taken from 
+ *	dataA[0] of the reply, or is the number itself if that is 0.
+ *	
+ *	Replies are stored by the CAN interrupt as they arrive, not when the inbox 
+ *	is read, so the CAN interrupt is held off while the cache and the queue 
+ *	are used from anywhere else.
+ */
+
+#include "lpc17xx_can.h"
+#include "canbus_msg.h"
+#include "debug_frmwrk.h"
+#include "serial.h"
+#include "lookup.h"
+
+#define LOOKUP_ENTRIES	8			// The number of lookups that can be cached
+#define LOOKUP_TTL		60000		// Time in ms a lookup is cached for
+#define LOOKUP_PENDING	4			// The number of lookups that can wait for a reply
+#define LOOKUP_WAIT		30000		// Time in ms a lookup waits for its reply
+
+typedef struct {
+	uint8_t			valid;			// 1 if the entry is in use
+	uint8_t			number;			// The number looked up
+	uint8_t			callid;			// The call ID returned by the exchange
+	uint8_t			station;		// The station the number belongs to
+	unsigned int	expires;		// The time in ms the entry expires at
+} LOOKUP_Type;
+
+LOOKUP_Type		cache[LOOKUP_ENTRIES];	// The cached lookups
+int				pending[LOOKUP_PENDING];// The numbers sent to the exchange, oldest first
+unsigned int	sent[LOOKUP_PENDING];	// The time in ms each was sent
+int				pendings = 0;		// The number of lookups waiting for a reply
+int				hits = 0;			// Lookups answered from the cache
+int				misses = 0;			// Lookups that had to go to the exchange
+
+/*	
+ *	lookupFind() looks for a number in the cache. Expired entries are 
+ *	removed as they are found.
+ *	
+ *	@param	number		The number to look up
+ *	@param	callid		Set to the cached call ID if found
+ *	@param	station		Set to the cached station if found
+ *	@return				1 if found (a hit), 0 if not (a miss)
+ */
+int lookupFind(int number, int *callid, int *station)
+{
+	int e, found = 0;
+	
+	NVIC_DisableIRQ(CAN_IRQn);
+	for(e=0; e<LOOKUP_ENTRIES && !found; e++)
+	{
+		if(!cache[e].valid) continue;
+		if((int)(cache[e].expires - ticks()) <= 0)
+		{
+			cache[e].valid = 0;				// Expired
+		}
+		else if(cache[e].number == number)
+		{
+			*callid = cache[e].callid;
+			*station = cache[e].station;
+			found = 1;
+		}
+	}
+	NVIC_EnableIRQ(CAN_IRQn);
+	
+	if(found)	hits++;
+	else		misses++;
+	return found;
+}
+
+/*	
+ *	lookupDrop() removes the oldest lookups from the queue.
+ *	
+ *	@param	n			The number of lookups to remove
+ */
+static void lookupDrop(int n)
+{
+	int p;
+	
+	pendings -= n;
+	for(p=0; p<pendings; p++)
+	{
+		pending[p] = pending[p+n];
+		sent[p] = sent[p+n];
+	}
+}
+
+/*	
+ *	lookupExpire() removes lookups that have waited longer than LOOKUP_WAIT, 
+ *	as the exchange has not answered them and their replies would otherwise 
+ *	be matched to the wrong numbers.
+ */
+static void lookupExpire()
+{
+	int p = 0;
+	
+	while(p < pendings && (int)(ticks() - sent[p]) >= LOOKUP_WAIT) p++;
+	lookupDrop(p);
+}
+
+/*	
+ *	lookupRequest() adds the number that a lookup is being sent to the 
+ *	exchange for to the queue, so the reply can be stored against it. If the 
+ *	queue is full the oldest lookup is given up on.
+ *	
+ *	@param	number		The number being looked up
+ */
+void lookupRequest(int number)
+{
+	NVIC_DisableIRQ(CAN_IRQn);
+	lookupExpire();
+	if(pendings == LOOKUP_PENDING) lookupDrop(1);
+	
+	pending[pendings] = number;
+	sent[pendings] = ticks();
+	pendings++;
+	NVIC_EnableIRQ(CAN_IRQn);
+}
+
+/*	
+ *	lookupStore() is called from the CAN interrupt when a call ID reply is 
+ *	received. It is stored 
+ *	against the number of the oldest lookup waiting, replacing an existing 
+ *	entry for that number, a free entry or the entry closest to expiring, in 
+ *	that order. Replies that are not from the exchange to this station, or 
+ *	that no lookup is waiting for, are ignored.
+ *	
+ *	@param	msg			The call ID reply received
+ */
+void lookupStore(const CAN_MSG_Type *msg)
+{
+	int e, use = 0;
+	int number;
+	
+	if(CAN_GET_SOURCE_ADD(msg->id) != CANADD_DNS || CAN_GET_TARGET_ADD(msg->id) != CANADD_SELF) return;
+	
+	lookupExpire();
+	if(pendings == 0) return;				// Not a reply to our lookup
+	number = pending[0];
+	lookupDrop(1);
+	
+	for(e=0; e<LOOKUP_ENTRIES; e++)
+	{
+		if(cache[e].valid && cache[e].number == number)
+		{
+			use = e;
+			break;
+		}
+		if(!cache[e].valid) use = e;
+		else if(cache[use].valid && (int)(cache[e].expires - cache[use].expires) < 0) use = e;
+	}
+	
+	cache[use].valid	= 1;
+	cache[use].number	= number;
+	cache[use].callid	= CAN_GET_CALLID(msg->id);
+	cache[use].station	= msg->dataA[0] ? msg->dataA[0] : number;
+	cache[use].expires	= ticks() + LOOKUP_TTL;
+}
+
+/*	
+ *	lookupClear() is called when a clear call ID message is received and 
+ *	removes any entries with that call ID, as it is no longer allocated.
+ *	
+ *	@param	msg			The clear call ID message received
+ */
+void lookupClear(const CAN_MSG_Type *msg)
+{
+	int e;
+	
+	NVIC_DisableIRQ(CAN_IRQn);
+	for(e=0; e<LOOKUP_ENTRIES; e++)
+	{
+		if(cache[e].valid && cache[e].callid == CAN_GET_CALLID(msg->id)) cache[e].valid = 0;
+	}
+	NVIC_EnableIRQ(CAN_IRQn);
+}
+
+/*	
+ *	lookupStats() prints the number of cache hits and misses to the terminal.
+ */
+void lookupStats()
+{
+	write_usb_serial_blocking("Lookup cache hits: ",19);
+	UARTPutDec16((LPC_UART_TypeDef *)LPC_UART0, hits);
+	write_usb_serial_blocking(" misses: ",9);
+	UARTPutDec16((LPC_UART_TypeDef *)LPC_UART0, misses);
+	write_usb_serial_blocking("\n\r",2);
+}
@@ -0,0 +1,9 @@
+/*	
+ *	@author		abradbury
+ */
+
+int lookupFind(int number, int *callid, int *station);
+void lookupRequest(int number);
+void lookupStore(const CAN_MSG_Type *msg);
+void lookupClear(const CAN_MSG_Type *msg);
+void lookupStats();
@@ -0,0 +1,55 @@
+/*	
+ *	@author		abradbury
+ *	
+ *	Memmap.h sets out what is placed in the two 16 KB AHB SRAM banks of the 
+ *	LPC1768. The main 32 KB SRAM holds the stack and the program's variables 
+ *	and is used by the CPU on nearly every instruction. Buffers that the DMA 
+ *	controller reads, and large queues, are kept out of it so DMA transfers 
+ *	and the CPU are not competing for the same memory:
+ *	 - bank 0 is the MSYS heap (which holds the decode arena)
+ *	 - bank 1 holds the DAC DMA buffers and the CAN receive queue
+ *	
+ *	The linker script comes with the CMSIS library and has no sections for 
+ *	the AHB banks, so these buffers are placed at fixed addresses, as the 
+ *	heap always has been. The addresses below are the only record of what is 
+ *	where, so anything new in a bank must be added here. Memory in these 
+ *	banks is not cleared at start up.
+ */
+
+#ifndef __MEMMAP_H
+#define __MEMMAP_H
+
+#define AHB_SRAM0		0x2007C000	// AHB SRAM bank 0
+#define AHB_SRAM1		0x20080000	// AHB SRAM bank 1
+#define AHB_SRAM_SIZE	0x4000		// Size of each bank
+#define MAIN_SRAM		0x10000000	// Main SRAM
+#define MAIN_SRAM_SIZE	0x8000
+
+// Main SRAM, the stack grows down from the top (see stack.c)
+#define STACK_TOP		(MAIN_SRAM + MAIN_SRAM_SIZE)
+#define STACK_PAINT		0x1000						// Bytes below the top the watermark covers
+
+// Bank 0, the MSYS heap
+#define HEAP_ADDR		AHB_SRAM0
+#define HEAP_SIZE		AHB_SRAM_SIZE
+
+// Bank 1, DMA buffers
+#define DAC_LLI_ADDR	AHB_SRAM1					// DAC DMA linked list entries, 2 of 16 bytes
+#define DAC_BUF_ADDR	(AHB_SRAM1 + 0x20)			// DAC sample buffers, 2 of DAC_BLOCK words
+#define DAC_BLOCK		128							// Samples in each buffer, 6.4 ms at 20 kHz
+
+// Bank 1, the CAN receive queue (see CAN_IRQHandler() in can.c)
+#define CANQ_ENTRIES	510							// Messages the queue can hold
+#define CANQ_SLOT		16							// sizeof(CAN_MSG_Type)
+#define CANQ_ADDR		(AHB_SRAM1 + 0x420)
+
+#define AHB_SRAM1_USED	(CANQ_ADDR + CANQ_SLOT*CANQ_ENTRIES - AHB_SRAM1)
+
+#if DAC_BUF_ADDR + 4*2*DAC_BLOCK > CANQ_ADDR
+#error "DAC buffers overlap the CAN queue"
+#endif
+#if AHB_SRAM1_USED > AHB_SRAM_SIZE
+#error "AHB SRAM bank 1 is full"
+#endif
+
+#endif
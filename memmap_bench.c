@@ -0,0 +1,114 @@
+/*	
+ *	@author		abradbury
+ *	
+ *	Memmap_bench.c is an on-board benchmark for the memory placement in 
+ *	memmap.h. It is only built when MEMMAP_BENCH is defined, and is then run 
+ *	once at start up, before the CAN interrupt is enabled.
+ *	
+ *	It times the work the CAN interrupt does for each frame, storing it in 
+ *	the receive queue and reading it back, using the Cortex-M3 cycle counter 
+ *	(DWT). This is done with the DAC DMA stopped and with it running flat 
+ *	out (a DMA timeout of 1), for each combination of the DAC buffers and the 
+ *	queue being in main SRAM or in AHB SRAM bank 1. The results are printed 
+ *	to the terminal in cycles per frame; the extra cycles over the stopped 
+ *	DMA figure are the stalls caused by sharing memory with the DMA.
+ */
+
+#ifdef MEMMAP_BENCH
+
+#include "lpc17xx_dac.h"
+#include "lpc17xx_gpdma.h"
+#include "lpc17xx_can.h"
+#include "debug_frmwrk.h"
+#include "serial.h"
+#include "dac.h"
+#include "string.h"
+#include "memmap.h"
+#include "synth.h"
+
+#define DEMCR		(*(volatile uint32_t *) 0xE000EDFC)	// Debug exception and monitor control
+#define DWT_CTRL	(*(volatile uint32_t *) 0xE0001000)	// DWT control
+#define DWT_CYCCNT	(*(volatile uint32_t *) 0xE0001004)	// DWT cycle counter
+
+#define FRAMES		4096		// Frames timed in each run
+#define ENTRIES		64			// Queue entries used, so the main SRAM copy is small
+
+extern GPDMA_LLI_Type * const	DMA_LinkList;
+extern uint32_t * const			dacBuffer;
+
+CAN_MSG_Type	mainQueue[ENTRIES];				// A queue in main SRAM
+uint32_t		mainBuffer[2*DAC_BLOCK];		// DAC buffers in main SRAM
+
+/*	
+ *	frames() stores FRAMES frames in a queue and reads them back, as 
+ *	CAN_IRQHandler() and decipher() do.
+ *	
+ *	@return				The cycles taken per frame
+ */
+static uint32_t frames(CAN_MSG_Type *queue)
+{
+	CAN_MSG_Type msg = {0x18006440, {1,2,3,4}, {5,6,7,8}, 8, EXT_ID_FORMAT, DATA_FRAME};
+	CAN_MSG_Type *slot;
+	uint32_t start, n;
+	
+	start = DWT_CYCCNT;
+	for(n=0; n<FRAMES; n++)
+	{
+		slot = &queue[n % ENTRIES];
+		*slot = msg;
+		msg.id = slot->id + slot->dataB[3] - 7;
+	}
+	return (DWT_CYCCNT - start) / FRAMES;
+}
+
+/*	
+ *	result() prints one line of results.
+ */
+static void result(char what[], uint32_t cycles)
+{
+	write_usb_serial_blocking(what, strlen(what));
+	UARTPutDec32((LPC_UART_TypeDef *)LPC_UART0, cycles);
+	write_usb_serial_blocking(" cycles/frame\n\r",15);
+}
+
+/*	
+ *	memmapBench() runs the benchmark and prints the results.
+ */
+void memmapBench(void)
+{
+	CAN_MSG_Type *bank1Queue = (CAN_MSG_Type *) CANQ_ADDR;
+	int s;
+	
+	DEMCR |= 1 << 24;						// Enable the DWT
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= 1;							// Start the cycle counter
+	
+	dacSetup();
+	NVIC_DisableIRQ(DMA_IRQn);				// Leave the buffers as they are
+	memcpy(mainBuffer, dacBuffer, sizeof(mainBuffer));
+	
+	write_usb_serial_blocking("\n\rMemory placement benchmark\n\r",31);
+	result(" DMA off,          queue main:  ", frames(mainQueue));
+	result(" DMA off,          queue bank1: ", frames(bank1Queue));
+	
+	for(s=0; s<2; s++)
+	{
+		uint32_t *src = s ? dacBuffer : mainBuffer;
+		
+		GPDMA_ChannelCmd(0, DISABLE);
+		DMA_LinkList[0].SrcAddr = (uint32_t)src;
+		DMA_LinkList[1].SrcAddr = (uint32_t)&src[DAC_BLOCK];
+		LPC_GPDMACH0->DMACCSrcAddr = (uint32_t)src;
+		DAC_SetDMATimeOut(LPC_DAC, 1);		// As fast as the DAC will take it
+		GPDMA_ChannelCmd(0, ENABLE);
+		
+		result(s ? " DMA from bank1, queue main:  " : " DMA from main,  queue main:  ", frames(mainQueue));
+		result(s ? " DMA from bank1, queue bank1: " : " DMA from main,  queue bank1: ", frames(bank1Queue));
+	}
+	
+	GPDMA_ChannelCmd(0, DISABLE);
+	DAC_SetDMATimeOut(LPC_DAC, CALFREQ*1000000/SYNTH_RATE);
+	dacSetup();
+}
+
+#endif
@@ -23,7 +23,7 @@
  *		 Text			Ringtone		  Voice			  Other			  Inbox			0		1		2		3		4
  *		  |					|				|				|				|			|		|		|		|		|
  *	 Desk Number	   Desk Number     	Yet to be 	 Select Command:	<decoded		10		10		12		13		X
- *		  |					|		   Implemented  <list of commands>	messages>		|		|			<130-133>	|
+ *		  |					|		   Implemented  <list of commands>	messages>		|		|			<130-135>	|
  *	Type a message	  Choose a tone:			  			|				|			20		11				|		|
  *	Press * to send	  <list of tones>						|		   Inbox Empty		|	<110-119>			|		14
  *		  |					|								|							|		|				|
@@ -43,15 +43,27 @@
 #include "string.h"
 #include "sevenseg.h"
 #include "text.h"
+#include "lookup.h"
+#include "arena.h"
+#include "workmem.h"
+#include "ringtones.h"
 
 #define WHOIS	0x14000441		// Who is? from bench 07 to broadcast
 #define BOUNCE	0x1400D440		// Bounce from bench 07 to exchange
 #define LOOKUP	0x14001440		// Network name lookup from bench 07 to exchange
 
-extern int 		bufMsgs;		// The number of messages in the buffer
+#define NO_SCREEN	-1			// menuScreen() has no further screen to show
+#define TONE_SCREEN	110			// The first screen of the ringtone list, one per ringtone
+
+#if TONE_SCREEN + RINGTONES > 130
+#error "The ringtone screens run into the command screens (130)"
+#endif
+
+extern volatile int bufMsgs;	// The number of messages in the buffer
 extern int		decMsgs;		// The number of messages that have been decoded
 int				unread;			// Used for the inbox, unread = bufMsgs - decMsgs
 int				morseEnable = 0;// A flag to enable morse code mode
+int				chimeEnable = 0;// A flag to play a chime when a text message arrives
 int 			prevKey = 0;	// Used for phone-like text input
 int 			currKey = 0;	// Used for phone-like text input
 int 			screen = 0;		// The current screen
@@ -66,12 +78,10 @@ int 			base = 0;		// For scrolling limiter
 int 			menuIndex = 4;	// Used to manage the menu scrolling
 int				deskDigit = 0;	// 0 if no value entered, non-zero if first digit entered
 int 			destination = 0;// Holds the address that the message will be sent to
-unsigned char	keyPressed = 0;	// Stores the most recent key pressed (for menuHandler())
 unsigned char	keyPressed2 = 0;// Stores the most recent key pressed (for lcdTextMsg())
 char 			position = '0';	// The position that text is to be placed on the LCD
 char			type = '0';		// Used to indicate a text, RTTTL or voice path down the tree
 char			unreadArray[4] = {'0','0','0','0'};	// An array to hold the digits of unread
-char 			lcdTxtBuf[30] = {' '};	// Used to printing out text messages to the LCD
 char 			lcdBuffer[100] = {' '};	// Buffers text typed on to the LCD
 int 			numOfVals[10] = {3,10,4,4,4,4,4,5,4,5};	// Holds the number of values for each of the keys.
 														// Eg 2 hold 4 values: a,b,c and 2.
@@ -100,6 +110,48 @@ char eight[] 	= "tuv8";
 char nine[] 	= "wxyz9";
 char zero[] 	= " 0\n";
 
+/*	
+ *	sending() shows the Sending... screen (21) while a message or command 
+ *	is sent from one of the other screens.
+ */
+void sending()
+{
+	clear_screen();
+	screen = 21;
+	level = 3;
+	mode = 3;
+	put_mult_char_lcd("Sending...",3,0);
+}
+
+/*	
+ *	toneScreen() shows a ringtone from the library (see ringtones.c) in the 
+ *	Choose a tone: list, and sends it to the destination and plays it when 
+ *	it is selected. Ringtone Sent, the screen that follows, shows the title 
+ *	again under it while it plays.
+ *	
+ *	@param	curScreen	The screen, TONE_SCREEN plus the index of the ringtone
+ *	@param	advance		1 if the user has selected it, else 0
+ *	@return				The screen that follows, NO_SCREEN if none
+ */
+static int toneScreen(int curScreen, int advance)
+{
+	const RINGTONE_Type *tone = &ringtones[curScreen - TONE_SCREEN];
+	
+	screen = curScreen;
+	level = 2;
+	mode = 1;
+	put_mult_char_lcd("Choose a tone:",1,1);
+	put_mult_char_lcd((char*)tone->title, (16-strlen(tone->title))/2, 2);
+	if(advance == 1)
+	{
+		sending();
+		tx_ringtone((char*)tone->rtttl, destination);
+		rtttlDecode((char*)tone->rtttl);
+		return 31;
+	}
+	return NO_SCREEN;
+}
+
 /*	
  *	menuScreen() is the main method to output text to the LCD representing the 
  *	different screens of the menu system. It is basically a large switch statement
@@ -107,418 +159,326 @@ char zero[] 	= " 0\n";
  *	the current values are printed out to the terminal and the system returns to 
  *	the main menu.
  *	
+ *	Some screens lead straight on to another, for example Ringtone Sent goes 
+ *	back to the main menu. These set next rather than calling menuScreen() 
+ *	again, and the loop around the switch draws the next screen, so the 
+ *	stack does not grow however many screens follow each other.
+ *	
  *	@param	curScreen	The current screen which the user is at.
  *	@param	advance		1 if the user has selected that screen, else 0.
  */
 void menuScreen(int curScreen, int advance)
 {
-	clear_screen();
+	int next;						// The screen that follows this one, if any
 	
-	switch(curScreen)
-	{			
-		case 99:
-			screen = 99;
-			level = 0;
-			mode = 0;
-			write_usb_serial_blocking("Welcome to the CAN Phone!",25);
-			put_mult_char_lcd("Welcome to the     CAN Phone!",0,0);
-			break;
-		case 0:
-			screen = 0;
-			level = 1;
-			mode = 1;
-			base = 0;
-			range = 5;
-			menuIndex = 5;
-			write_usb_serial_blocking("Text",4);
-			put_mult_char_lcd("Main Menu",3,1);
-			put_mult_char_lcd("    Text",2,2);
-			if(advance == 1)
-			{
-				type = 't';
-				menuScreen(10,0);
-			}
-			break;
-		case 1:
-			screen = 1;
-			level = 1;
-			mode = 1;
-			write_usb_serial_blocking("Ringtone",8);
-			put_mult_char_lcd("Main Menu",3,1);
-			put_mult_char_lcd("  Ringtone",2,2);
-			if(advance == 1)
-			{
-				type = 'r';
-				menuScreen(10,0);
-			}
-			break;
-		case 2:
-			screen = 2;
-			level = 1;
-			mode = 1;
-			write_usb_serial_blocking("Voice",5);
-			put_mult_char_lcd("Main Menu",3,1);
-			put_mult_char_lcd("   Voice",2,2);
-			if(advance == 1)
-			{
-				type = 'v';
-				menuScreen(12,0);
-			}
-			break;
-		case 3:
-			screen = 3;
-			level = 1;
-			mode = 1;
-			write_usb_serial_blocking("Other",5);
-			put_mult_char_lcd("Main Menu",3,1);
-			put_mult_char_lcd("   Other",2,2);
-			if(advance == 1)
-			{
-				menuScreen(13,0);
-			}
-			break;
-		case 4:
-			screen = 4;
-			level = 1;
-			mode = 1;
-			write_usb_serial_blocking("Inbox",5);
-			put_mult_char_lcd("Main Menu",3,1);
-			put_mult_char_lcd(" Inbox-",2,2);
-			unread = bufMsgs - decMsgs;
-			int urCount = 3;
-			while (unread > 0) 		// Splits unread up into single digits
-		 	{
-		 		unreadArray[urCount--] = (char)(unread % 10)+48;
-		 		unread = unread/10;
-		 	}
-			put_char_lcd(unreadArray[0]|0x80,9+0x40);
-			put_char_lcd(unreadArray[1]|0x80,10+0x40);
-			put_char_lcd(unreadArray[2]|0x80,11+0x40);
-			put_char_lcd(unreadArray[3]|0x80,12+0x40);
-			if(advance == 1)
-			{
-				inbox();
-				menuScreen(14,0);
-			}
-			break;
+	do
+	{
+		next = NO_SCREEN;
+		clear_screen();
+		
+		switch(curScreen)
+		{			
+			case 99:
+				screen = 99;
+				level = 0;
+				mode = 0;
+				write_usb_serial_blocking("Welcome to the CAN Phone!",25);
+				put_mult_char_lcd("Welcome to the     CAN Phone!",0,0);
+				break;
+			case 0:
+				screen = 0;
+				level = 1;
+				mode = 1;
+				base = 0;
+				range = 5;
+				menuIndex = 5;
+				write_usb_serial_blocking("Text",4);
+				put_mult_char_lcd("Main Menu",3,1);
+				put_mult_char_lcd("    Text",2,2);
+				if(advance == 1)
+				{
+					type = 't';
+					next = 10;
+				}
+				break;
+			case 1:
+				screen = 1;
+				level = 1;
+				mode = 1;
+				write_usb_serial_blocking("Ringtone",8);
+				put_mult_char_lcd("Main Menu",3,1);
+				put_mult_char_lcd("  Ringtone",2,2);
+				if(advance == 1)
+				{
+					type = 'r';
+					next = 10;
+				}
+				break;
+			case 2:
+				screen = 2;
+				level = 1;
+				mode = 1;
+				write_usb_serial_blocking("Voice",5);
+				put_mult_char_lcd("Main Menu",3,1);
+				put_mult_char_lcd("   Voice",2,2);
+				if(advance == 1)
+				{
+					type = 'v';
+					next = 12;
+				}
+				break;
+			case 3:
+				screen = 3;
+				level = 1;
+				mode = 1;
+				write_usb_serial_blocking("Other",5);
+				put_mult_char_lcd("Main Menu",3,1);
+				put_mult_char_lcd("   Other",2,2);
+				if(advance == 1)
+				{
+					next = 13;
+				}
+				break;
+			case 4:
+				screen = 4;
+				level = 1;
+				mode = 1;
+				write_usb_serial_blocking("Inbox",5);
+				put_mult_char_lcd("Main Menu",3,1);
+				put_mult_char_lcd(" Inbox-",2,2);
+				unread = bufMsgs - decMsgs;
+				int urCount = 3;
+				while (unread > 0) 		// Splits unread up into single digits
+			 	{
+			 		unreadArray[urCount--] = (char)(unread % 10)+48;
+			 		unread = unread/10;
+			 	}
+				put_char_lcd(unreadArray[0]|0x80,9+0x40);
+				put_char_lcd(unreadArray[1]|0x80,10+0x40);
+				put_char_lcd(unreadArray[2]|0x80,11+0x40);
+				put_char_lcd(unreadArray[3]|0x80,12+0x40);
+				if(advance == 1)
+				{
+					inbox();
+					next = 14;
+				}
+				break;
 			
-		case 10:
-			screen = 10;
-			level = 2;
-			mode = 2;
-			write_usb_serial_blocking("Desk number:",12);
-			put_mult_char_lcd("Desk number:",2,1);
-			break;
-		case 20:
-			screen = 20;
-			level = 3;
-			mode = 2;
-			textIntro = 1;
-			put_mult_char_lcd("Type a message",0,1);
-			put_mult_char_lcd("Press * to send",0,2);
-			if(advance == 1)
-			{
-				menuScreen(30,0);
-			}
-			break;
-		case 30:
-			screen = 30;
-			level = 4;
-			mode = 3;
-			put_mult_char_lcd("Sending...",3,1);
-			break;
+			case 10:
+				screen = 10;
+				level = 2;
+				mode = 2;
+				write_usb_serial_blocking("Desk number:",12);
+				put_mult_char_lcd("Desk number:",2,1);
+				break;
+			case 20:
+				screen = 20;
+				level = 3;
+				mode = 2;
+				textIntro = 1;
+				put_mult_char_lcd("Type a message",0,1);
+				put_mult_char_lcd("Press * to send",0,2);
+				if(advance == 1)
+				{
+					next = 30;
+				}
+				break;
+			case 30:
+				screen = 30;
+				level = 4;
+				mode = 3;
+				put_mult_char_lcd("Sending...",3,1);
+				break;
 			
-		case 11:
-			screen = 11;
-			level = 2;
-			mode = 1;
-			base = 110;
-			range = 10;
-			menuIndex = 10;
-			put_mult_char_lcd(" Choose a tone:",2,1);
-			menuScreen(110,0);
-			break;
-		case 110:
-			screen = 110;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose a tone:",1,1);
-			put_mult_char_lcd("Abdelazer",4,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				tx_text("Abdelazer:d=4,o=5,b=160:2d,2f,2a,d6,8e6,8f6,8g6,8f6,8e6,8d6,2c#6,a6,8d6,8f6,8a6,8f6,d6,2a6,g6,8c6,8e6,8g6,8e6,c6,2a6,f6,8b,8d6,8f6,8d6,b,2g6,e6,8a,8c#6,8e6,8c6,a,2f6,8e6,8f6,8e6,8d6,c#6,f6,8e6,8f6,8e6,8d6,a,d6,8c#6,8d6,8e6,8d6,2d6", destination, 'r');
-				rtttlDecode("Abdelazer:d=4,o=5,b=160:2d,2f,2a,d6,8e6,8f6,8g6,8f6,8e6,8d6,2c#6,a6,8d6,8f6,8a6,8f6,d6,2a6,g6,8c6,8e6,8g6,8e6,c6,2a6,f6,8b,8d6,8f6,8d6,b,2g6,e6,8a,8c#6,8e6,8c6,a,2f6,8e6,8f6,8e6,8d6,c#6,f6,8e6,8f6,8e6,8d6,a,d6,8c#6,8d6,8e6,8d6,2d6");
-				menuScreen(31,0);
-			}
-			break;
-		case 111:
-			screen = 111;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose a tone:",1,1);
-			put_mult_char_lcd("James Bond",3,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				tx_text("jamesbond:d=8,o=5,b=160:e,g,p,d#6,d6,4p,g,a#,b,2p.,g,16a,16g,f#,4p,b4,e,c#,1p", destination, 'r');
-				rtttlDecode("jamesbond:d=8,o=5,b=160:e,g,p,d#6,d6,4p,g,a#,b,2p.,g,16a,16g,f#,4p,b4,e,c#,1p");
-				menuScreen(31,0);
-			}
-			break;
-		case 112:
-			screen = 112;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose a tone:",1,1);
-			put_mult_char_lcd("Nokia Tune",3,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				tx_text("nokiatune:d=4,o=5,b=112:8e6,8d6,f#,g#,8c#6,8b,d,e,8b,8a,c#,e,2a", destination, 'r');
-				rtttlDecode("nokiatune:d=4,o=5,b=112:8e6,8d6,f#,g#,8c#6,8b,d,e,8b,8a,c#,e,2a");
-				menuScreen(31,0);
-			}
-			break;
-		case 113:
-			screen = 113;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose a tone:",1,1);
-			put_mult_char_lcd("Tubular Bells",1,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				tx_text("Tubular Bells:d=4,o=5,b=280:c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6,c6,g6,c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6,c6,g6,c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6,c6,g6,c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6", destination, 'r');
-				rtttlDecode("Tubular Bells:d=4,o=5,b=280:c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6,c6,g6,c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6,c6,g6,c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6,c6,g6,c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6");
-				menuScreen(31,0);
-			}
-			break;
-		case 114:
-			screen = 114;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose a tone:",1,1);
-			put_mult_char_lcd("Indiana Jones",1,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				tx_text("IndianaJ:d=4,o=5,b=125:4e,16f,8g,2c6,4d,16e,1f,4g,16a,8b,2f6,4a,16b,4c6,4d6,4e6,4e,16f,8g,1c6,4d6,16e6,2f6,4g,16g,4e6,4d6,16g,4e6,4d6,16g,4f6,4e6,16d6,2c6", destination, 'r');
-				rtttlDecode("IndianaJ:d=4,o=5,b=125:4e,16f,8g,2c6,4d,16e,1f,4g,16a,8b,2f6,4a,16b,4c6,4d6,4e6,4e,16f,8g,1c6,4d6,16e6,2f6,4g,16g,4e6,4d6,16g,4e6,4d6,16g,4f6,4e6,16d6,2c6");
-				menuScreen(31,0);
-			}
-			break;
-		case 115:
-			screen = 115;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose a tone:",1,1);
-			put_mult_char_lcd("Thunderbirds",2,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				tx_text("Thunderb:d=4,o=5,b=125:8g#,16f,16g#,4a#,8p,16d#,16f,8g#,8a#,8d#6,16f6,16c6,8d#6,8f6,2a#,8g#,16f,16g#,4a#,8p,16d#,16f,8g#,8a#,8d#6,16f6,16c6,8d#6,8f6,2g6,8g6,16a6,16e6,4g6,8p,16e6,16d6,8c6,8b,8a,16b,8c6,8e6,2d6", destination, 'r');
-				rtttlDecode("Thunderb:d=4,o=5,b=125:8g#,16f,16g#,4a#,8p,16d#,16f,8g#,8a#,8d#6,16f6,16c6,8d#6,8f6,2a#,8g#,16f,16g#,4a#,8p,16d#,16f,8g#,8a#,8d#6,16f6,16c6,8d#6,8f6,2g6,8g6,16a6,16e6,4g6,8p,16e6,16d6,8c6,8b,8a,16b,8c6,8e6,2d6");
-				menuScreen(31,0);
-			}
-			break;
-		case 116:
-			screen = 116;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose a tone:",1,1);
-			put_mult_char_lcd("Inspect Gadget",1,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				tx_text("Insepect:d=4,o=5,b=200:8g,8a,8p,8f,8p,8g#,8p,8e,8p,8g,8p,8f,8p,8d,8e,8f,8g,8a,8p,4d6,2c#6,2p,8d,8e,8f,8g,8a,8p,8f,8p,8g#,8p,8e,8p,8g,8p,8f,8p,4d,2p,4c#,4d", destination, 'r');
-				rtttlDecode("Insepect:d=4,o=5,b=200:8g,8a,8p,8f,8p,8g#,8p,8e,8p,8g,8p,8f,8p,8d,8e,8f,8g,8a,8p,4d6,2c#6,2p,8d,8e,8f,8g,8a,8p,8f,8p,8g#,8p,8e,8p,8g,8p,8f,8p,4d,2p,4c#,4d");
-				menuScreen(31,0);
-			}
-			break;
-		case 117:
-			screen = 117;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose a tone:",1,1);
-			put_mult_char_lcd("Superman",4,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				tx_text("SuperMan:d=4,o=5,b=180:8g,8g,8g,c6,8c6,2g6,8p,8g6,8a.6,16g6,8f6,1g6,8p,8g,8g,8g,c6,8c6,2g6,8p,8g6,8a.6,16g6,8f6,8a6,2g.6,p,8c6,8c6,8c6,2b.6,g.6,8c6,8c6,8c6,2b.6,g.6,8c6,8c6,8c6,8b6,8a6,8b6,2c7,8c6,8c6,8c6,8c6,8c6,2c.6", destination, 'r');
-				rtttlDecode("SuperMan:d=4,o=5,b=180:8g,8g,8g,c6,8c6,2g6,8p,8g6,8a.6,16g6,8f6,1g6,8p,8g,8g,8g,c6,8c6,2g6,8p,8g6,8a.6,16g6,8f6,8a6,2g.6,p,8c6,8c6,8c6,2b.6,g.6,8c6,8c6,8c6,2b.6,g.6,8c6,8c6,8c6,8b6,8a6,8b6,2c7,8c6,8c6,8c6,8c6,8c6,2c.6");
-				menuScreen(31,0);
-			}
-			break;
-		case 118:
-			screen = 118;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose a tone:",1,1);
-			put_mult_char_lcd("Star Trek",3,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				tx_text("Star Trek:d=4,o=5,b=063:8f.,16a#,d#.6,8d6,16a#.,16g.,16c.6,f6",destination,'r');
-				rtttlDecode("Star Trek:d=4,o=5,b=063: 8f.,16a#,d#.6,8d6,16a#.,16g.,16c.6,f6");
-				menuScreen(31,0);
-			}
-			break;
-		case 119:
-			screen = 119;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose a tone:",1,1);
-			put_mult_char_lcd("Star Wars",3,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				tx_text("StWars:d=4,o=5,b=180:8f,8f,8f,2a#.,2f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8d#6,2c6,p,8f,8f,8f,2a#.,2f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8d#6,2c6",destination, 'r');
-				rtttlDecode("StWars:d=4,o=5,b=180:8f,8f,8f,2a#.,2f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8d#6,2c6,p,8f,8f,8f,2a#.,2f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8d#6,2c6");
-				menuScreen(31,0);
-			}
-			break;
-		case 21:
-			screen = 21;
-			level = 3;
-			mode = 3;
-			put_mult_char_lcd("Sending...",3,0);
-			break;
-		case 31:
-			screen = 31;
-			level = 4;
-			mode = 3;
-			clear_screen();
-			put_mult_char_lcd("Ringtone Sent",1,1);
-			delay(7000);
-			menuScreen(0,0);
-			break;
+			case 11:
+				screen = 11;
+				level = 2;
+				mode = 1;
+				base = TONE_SCREEN;
+				range = RINGTONES;
+				menuIndex = RINGTONES;
+				put_mult_char_lcd(" Choose a tone:",2,1);
+				next = TONE_SCREEN;
+				break;
+			case 21:
+				sending();
+				break;
+			case 31:
+				screen = 31;
+				level = 4;
+				mode = 3;
+				clear_screen();
+				put_mult_char_lcd("Ringtone Sent",1,1);
+				if(rtttlName()) put_mult_char_lcd((char*)rtttlName(),1,2);	// Still playing
+				delay(7000);
+				next = 0;
+				break;
 						
-		case 12:
-			screen = 12;
-			level = 2;
-			mode = 3;
-			put_mult_char_lcd("Yet to be ",3,1);
-			put_mult_char_lcd("Implemented",2,2);
-			delay(7000);
-			menuScreen(0,0);
-			break;
+			case 12:
+				screen = 12;
+				level = 2;
+				mode = 3;
+				put_mult_char_lcd("Yet to be ",3,1);
+				put_mult_char_lcd("Implemented",2,2);
+				delay(7000);
+				next = 0;
+				break;
 			
-		case 13:
-			screen = 13;
-			level = 2;
-			mode = 1;
-			base = 130;
-			range = 4;
-			menuIndex = 4;
-			put_mult_char_lcd("Choose command:",0,1);
-			menuScreen(130,0);
-			break;
+			case 13:
+				screen = 13;
+				level = 2;
+				mode = 1;
+				base = 130;
+				range = 6;
+				menuIndex = 6;
+				put_mult_char_lcd("Choose command:",0,1);
+				next = 130;
+				break;
 		
-		case 130:
-			screen = 130;
-			level = 2;
-			mode = 1;	
-			put_mult_char_lcd("Choose command:",0,1);
-			put_mult_char_lcd("Who Is Online?",1,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				send_CAN(WHOIS, DATA_FRAME, 0x00, 0x00);
-				menuScreen(33,0);
-			}
-			break;
-		case 131:
-			screen = 131;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose command:",0,1);
-			put_mult_char_lcd("Number Lookup",2,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				send_CAN(LOOKUP, DATA_FRAME, 0x00, 0x00);
-				menuScreen(33,0);
-			}
-			break;
-		case 132:
-			screen = 132;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose command:",0,1);
-			put_mult_char_lcd("Bounce",4,2);
-			if(advance == 1)
-			{
-				menuScreen(21,0);
-				send_CAN(BOUNCE, DATA_FRAME, 0x00, 0x00);
-				menuScreen(33,0);
-			}
-			break;
-		case 133:
-			screen = 133;
-			level = 2;
-			mode = 1;
-			put_mult_char_lcd("Choose command:",0,1);
-			put_mult_char_lcd("Morse Mode",3,2);
-			if(advance == 1)
-			{
-				if(morseEnable == 1)
+			case 130:
+				screen = 130;
+				level = 2;
+				mode = 1;	
+				put_mult_char_lcd("Choose command:",0,1);
+				put_mult_char_lcd("Who Is Online?",1,2);
+				if(advance == 1)
+				{
+					sending();
+					send_CAN(WHOIS, DATA_FRAME, 0x00, 0x00);
+					next = 33;
+				}
+				break;
+			case 131:
+				screen = 131;
+				level = 2;
+				mode = 1;
+				put_mult_char_lcd("Choose command:",0,1);
+				put_mult_char_lcd("Number Lookup",2,2);
+				if(advance == 1)
+				{
+					type = 'l';
+					next = 10;
+				}
+				break;
+			case 132:
+				screen = 132;
+				level = 2;
+				mode = 1;
+				put_mult_char_lcd("Choose command:",0,1);
+				put_mult_char_lcd("Bounce",4,2);
+				if(advance == 1)
 				{
-					morseEnable = 0;
+					sending();
+					send_CAN(BOUNCE, DATA_FRAME, 0x00, 0x00);
+					next = 33;
+				}
+				break;
+			case 133:
+				screen = 133;
+				level = 2;
+				mode = 1;
+				put_mult_char_lcd("Choose command:",0,1);
+				put_mult_char_lcd("Morse Mode",3,2);
+				if(advance == 1)
+				{
+					if(morseEnable == 1)
+					{
+						morseEnable = 0;
+						clear_screen();
+						put_mult_char_lcd("Morse Off",4,2);
+					}
+					else if(morseEnable == 0)
+					{
+						morseEnable = 1;
+						clear_screen();
+						put_mult_char_lcd("Morse On",5,2);
+					}
+					delay(7000);
+					next = 0;	
+				}
+				break;
+			case 134:
+				screen = 134;
+				level = 2;
+				mode = 1;
+				put_mult_char_lcd("Choose command:",0,1);
+				put_mult_char_lcd("Ringtone Sound",1,2);
+				if(advance == 1)
+				{
+					const char *name = nextShape();
 					clear_screen();
-					put_mult_char_lcd("Morse Off",4,2);
+					put_mult_char_lcd((char*)name, (16-strlen(name))/2, 2);
+					delay(7000);
+					next = 0;
 				}
-				else if(morseEnable == 0)
+				break;
+			case 135:
+				screen = 135;
+				level = 2;
+				mode = 1;
+				put_mult_char_lcd("Choose command:",0,1);
+				put_mult_char_lcd("Message Chime",1,2);
+				if(advance == 1)
 				{
-					morseEnable = 1;
+					chimeEnable = !chimeEnable;
 					clear_screen();
-					put_mult_char_lcd("Morse On",5,2);
+					if(chimeEnable) put_mult_char_lcd("Chime On",4,2);
+					else put_mult_char_lcd("Chime Off",3,2);
+					delay(7000);
+					next = 0;
 				}
-				delay(7000);
-				menuScreen(0,0);	
-			}
-			break;
-		case 33:
-			screen = 33;
-			level = 4;
-			mode = 3;
-			clear_screen();
-			put_mult_char_lcd("Command Sent",2,1);
-			delay(4000);
-			menuScreen(0,0);
-			break;
+				break;
+			case 33:
+				screen = 33;
+				level = 4;
+				mode = 3;
+				clear_screen();
+				put_mult_char_lcd("Command Sent",2,1);
+				delay(4000);
+				next = 0;
+				break;
 			
-		case 14:
-			screen = 14;
-			level = 2;
-			mode = 3;
-			put_mult_char_lcd("Inbox Empty",2,1);
-			delay(7000);
-			menuScreen(0,0);
-			break;
+			case 14:
+				screen = 14;
+				level = 2;
+				mode = 3;
+				put_mult_char_lcd("Inbox Empty",2,1);
+				delay(7000);
+				next = 0;
+				break;
 			
-		default:
-			put_mult_char_lcd("Error",6,0);
+			default:
+				if(curScreen >= TONE_SCREEN && curScreen < TONE_SCREEN+RINGTONES)
+				{
+					next = toneScreen(curScreen, advance);
+					break;
+				}
+				put_mult_char_lcd("Error",6,0);
 			
-			write_usb_serial_blocking("Error - screen(",15);
-			UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, screen);
-			write_usb_serial_blocking("), level(",9);
-			UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, level);
-			write_usb_serial_blocking("), mode(",8);
-			UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, mode);
-			write_usb_serial_blocking("), menuIndex(",13);
-			UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, menuIndex);
-			write_usb_serial_blocking("), base(",8);
-			UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, base);
-			write_usb_serial_blocking("), range(",9);
-			UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, range);
-			write_usb_serial_blocking(").\n\r",4);
+				write_usb_serial_blocking("Error - screen(",15);
+				UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, screen);
+				write_usb_serial_blocking("), level(",9);
+				UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, level);
+				write_usb_serial_blocking("), mode(",8);
+				UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, mode);
+				write_usb_serial_blocking("), menuIndex(",13);
+				UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, menuIndex);
+				write_usb_serial_blocking("), base(",8);
+				UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, base);
+				write_usb_serial_blocking("), range(",9);
+				UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, range);
+				write_usb_serial_blocking(").\n\r",4);
 			
-			mode = 1;
-			delay(7000);
-			menuScreen(0,0);
-			break;
+				mode = 1;
+				delay(7000);
+				next = 0;
+				break;
+		}
+		
+		curScreen = next;
+		advance = 0;
 	}
+	while(curScreen != NO_SCREEN);
 	
 	if(mode == 1)
 	{
@@ -530,8 +490,8 @@ void menuScreen(int curScreen, int advance)
 /*	
  *	menuHandler() computes what actions are to be taken when a key is pressed based 
  *	on what the current variables are. It is a large case statement that switches on 
- *	the key pressed. There are lots of inline comments to aid understanding. At the 
- *	end of the method is a recursive call.
+ *	the key pressed. There are lots of inline comments to aid understanding. It 
+ *	deals with one key and returns, main() calls it for every key pressed.
  *	
  *	@param	k			The key pressed 
  */
@@ -626,6 +586,9 @@ void menuHandler(unsigned char k)
 				clear_screen();
 				position = 0;
 				bufpos = 0;
+				mode = 2;
+				write_usb_serial_blocking("\n\rCLEARED",11);
+				delay(800);
 			}
 			break;
 		case 0xB4 :					//4
@@ -717,6 +680,7 @@ void menuHandler(unsigned char k)
 			{
 				clear_screen();
 				put_mult_char_lcd(lcdBuffer,0,0);//restore	
+				mode = 2;
 			}
 			
 			break;
@@ -808,10 +772,11 @@ void menuHandler(unsigned char k)
 				if(screen == 20)	// Text msg input
 				{
 					menuScreen(30,0);
-					tx_text(lcdBuffer, destination, 't');
+					int sent = tx_text(lcdBuffer, destination, 't');
 					for(z=0; z<=bufpos; z++) lcdBuffer[z] = ' ';
 					clear_screen();
-					put_mult_char_lcd("Message Sent",3,1);
+					if(sent) put_mult_char_lcd("Message Sent",3,1);
+					else put_mult_char_lcd("Not Delivered",2,1);
 					delay(2000);
 					menuScreen(0,0);
 				}
@@ -867,18 +832,6 @@ void menuHandler(unsigned char k)
 			// Do nothing
 			break;
 	} 
-	
-	keyPressed = key_to_charcode(readkey());
-	
-	do
-	{
-		menuHandler(keyPressed);
-	}
-	while(1);
-	
-	clear_screen();
-	put_mult_char_lcd("End",0,0);
-	
 }
 
 /*	
@@ -898,7 +851,9 @@ int limit(int input)
  *	textEntry() deals with when the system is in text entry mode so that the
  *	keypad acts like a phone keypad. For example, pressing key 2 twice would 
  *	output a 'b'. The C key is used to clear the screen, D for deleting a 
- *	single character, * is used to send.
+ *	single character, * is used to send. C asks before clearing; the answer 
+ *	is the next key, which menuHandler() deals with in mode 4 (A to clear, 
+ *	B to keep the text).
  *
  *	It was planned to have it so that if the same key is pressed within X ms 
  *	of the previous key press then the value would increment (eg a -> b). 
@@ -943,11 +898,7 @@ void textEntry(char inputValues[], int key)
 	{
 		clear_screen();
 		put_mult_char_lcd(" Clear screen?", 0, 0);
-		mode = 4;
-		menuHandler(key_to_charcode(readkey()));
-		mode = 2;
-		write_usb_serial_blocking("\n\rCLEARED",11);
-		delay(800);
+		mode = 4;			// menuHandler() takes the answer, A or B
 	}
 	else if(prevKey == currKey)	// Multiple presses of the same key
 	{
@@ -1053,6 +1004,10 @@ void numberEntry(char value)
 		{
 			// Not yet implemented
 		}
+		else if(type == 'l')		// If lookup thread
+		{
+			numberLookup(destination);
+		}
 	}
 	
 	write_usb_serial_blocking(" - deskDigit(",13);
@@ -1066,6 +1021,43 @@ void numberEntry(char value)
 	delay(800);
 }
 
+/*	
+ *	numberLookup() looks up a desk number. If the answer is in the lookup 
+ *	cache it is shown straight away, else a lookup is sent to the exchange 
+ *	and the reply is cached by the CAN interrupt when it arrives.
+ *	
+ *	@param	number		The desk number to look up
+ */
+void numberLookup(int number)
+{
+	int callid, station;
+	char found[] = "Call ID: 00";
+	char stat[] = "Station: 00";
+	
+	if(lookupFind(number, &callid, &station))
+	{
+		found[9] = '0' + callid/10;
+		found[10] = '0' + callid%10;
+		stat[9] = '0' + station/10;
+		stat[10] = '0' + station%10;
+		
+		clear_screen();
+		put_mult_char_lcd(found,2,1);
+		put_mult_char_lcd(stat,2,2);
+		delay(10000);
+	}
+	else
+	{
+		sending();
+		lookupRequest(number);
+		send_CAN(LOOKUP, DATA_FRAME, number, 0x00);
+	}
+	lookupStats();
+	
+	if(screen == 21)	menuScreen(33,0);
+	else				menuScreen(0,0);
+}
+
 /*	
  *	lcdTextMsg() is a method for displaying received messages on the LCD.
  *	It places 30 characters at a time on the LCD with the ability to scroll 
@@ -1074,6 +1066,9 @@ void numberEntry(char value)
  *	no longer displayed, though line 2 is, now occupying line 1. This is to
  *	remind the user what they just read.
  *	
+ *	The 30 characters shown are copied into a window borrowed from the shared 
+ *	working memory (see workmem.c) while the message is on the screen.
+ *	
  *	@param	text			The received text to display 
  *	@param	size			The number of characters 
  */
@@ -1081,6 +1076,16 @@ void lcdTextMsg(char text[], int size)
 {
 	mode = 5;
 	int counter = 0;
+	char *lcdTxtBuf;
+	
+	if(!workTake(WORK_DISPLAY)) return;
+	lcdTxtBuf = arenaAlloc(&decodeArena, 31);
+	if(lcdTxtBuf == 0)
+	{
+		workGive(WORK_DISPLAY);
+		return;
+	}
+	lcdTxtBuf[30] = '\0';
 	
 	do
 	{
@@ -1091,7 +1096,7 @@ void lcdTextMsg(char text[], int size)
 		
 		for(f = 0; f < 30; f++)
 		{
-			lcdTxtBuf[f] = text[f+counter];
+			lcdTxtBuf[f] = (f+counter < size) ? text[f+counter] : ' ';
 		}
 	
 		put_mult_char_lcd(lcdTxtBuf, 1, 0);
@@ -1111,6 +1116,7 @@ void lcdTextMsg(char text[], int size)
 	while(!(keyPressed2 == 0xC2));
 	
 	clear_screen();
+	workGive(WORK_DISPLAY);
 	
 	mode = 2;
 	delay(800);
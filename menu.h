@@ -2,10 +2,12 @@
  *	@author		abradbury
  */
 
+void sending();
 void menuScreen(int curScreen, int advance);
 void menuHandler(unsigned char k);
 int limit(int input);
 void textEntry(char inputValues[], int key);
 void numberEntry(char value);
+void numberLookup(int number);
 void lcdTextMsg(char text[], int size);
 void inbox();
@@ -18,12 +18,15 @@
 #include "lcd.h"
 #include "string.h"
 #include "ctype.h"
+#include "workmem.h"
+#include "stack.h"
+#include "tone.h"
 
 #define	MORSENOTE	1046.52
 
-float 		t = 0;	// Time in milliseconds
+int 		t = 0;	// Time in milliseconds
 int 		m = 0;	// Counter for the string to be converted to morse
-float		morseNote = 523.26;	// The note frequency that morse code values are played at (corresponds to a 5th octave C)
+uint16_t	morseNote = 0;	// The note that morse code values are played at (a 5th octave C, 523.26 Hz)
 
 /*	
  *	initMorse() initialises the morse code base typing rate. Skilled 
@@ -34,7 +37,8 @@ float		morseNote = 523.26;	// The note frequency that morse code values are play
 void init_morse(int wordPerMin)
 {
 	write_usb_serial_blocking("Morse initialised\n\r",19);
-	t = 1200/(float)wordPerMin;	
+	t = 1200/wordPerMin;
+	morseNote = toneNote(1, 5);
 }
 
 /*	
@@ -46,16 +50,20 @@ void init_morse(int wordPerMin)
  */
 void morseParse(char str[])
 {
+	if(!workTake(WORK_MORSE)) return;
+	STACK_BEGIN(STACK_MORSE);
+	
 	put_mult_char_lcd("Decoding message",0,1);
 	put_mult_char_lcd("to Morse Code",1,2);
 
 	for(m=0; m<=strlen(str); m++)
 	{
-		sineSetup();
 		morseCode(str[m]);
 	}
 	
 	clear_screen();
+	workGive(WORK_MORSE);
+	STACK_END(STACK_MORSE);
 }
 
 /*	
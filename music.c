@@ -1,311 +1,378 @@
 /*	
  *	@author		abradbury
  * 
- *	Music.c handles received RTTTL messages. It parses the received data, and 
- *	creates the frequency and duration values to be played, finally it plays 
- *	the received message.
+ *	Music.c handles received RTTTL messages. It parses the received data into 
+ *	note events, the note number and duration of each note, and plays them. The 
+ *	events are kept in the ringtone cache (see tone.c), so a ringtone played 
+ *	again is not parsed again. The RTTTL text is parsed in one pass by the 
+ *	parser in rtttl.c, which gives each note to rtttlNote() as it is read.
  */
 
-#include "lpc17xx_timer.h"
-#include "lpc17xx_gpdma.h"
 #include "debug_frmwrk.h"
 #include "serial.h"
 #include "music.h"
 #include "dac.h"
 #include "lcd.h"
 #include "string.h"
-#include "ctype.h"
+#include "stack.h"
+#include "tone.h"
+#include "rtttl.h"
+#include "seq.h"
+#include "synth.h"
+#include "ringtones.h"
 
-char			name[32];		// Array to hold RTTTL name (spec limit is 10 characters)
-char			defaults[32];	// Array to hold the default duration, ocatve and bpm
-char			data[255];		// Array to hold the RTTTL data
-float 			freq[255];		// Array to hold the calculated RTTTL frequencies
-float 			dura[255];		// Array to hold the calculated RTTTL durations
+TONE_Type		*tone;			// The ringtone being compiled or played
+int				notes = 0;		// The number of events tone can hold
+char			playName[17];	// The name shown for the ringtone playing, a line of the LCD
 
 int 			ddur = 0;		// Default duration
 int 			doct = 0;		// Default ocatve
 int 			dbpm = 0;		// Default BPM
-int 			k = 0;			// Data size counter
-int 			x = 0;			// Frequency and duration size counter
-float 			prevNote = 0;	// Holds the previous note played, to introduce a gap
 
-TIM_TIMERCFG_Type	Timer0;		// The timer struct used for note timing
-TIM_MATCHCFG_Type	Match0;		// The match struct used for note timing
+int				toneShape = SYNTH_SINE;	// The wave ringtones are played with
+const char		*shapeNames[SYNTH_SHAPES] = {"Sine", "Square", "Triangle", "Saw"};
+
+// Note stream duration codes 0-5, codes 6 and 7 are not used
+const int		noteDurations[8] = {1, 2, 4, 8, 16, 32, 4, 4};
+
+typedef struct {
+	uint8_t		*out;			// The note stream
+	int			size;			// The size of out
+	int			len;			// The bytes written, 0 until the first note
+	int			oct;			// The octave of the last note
+	int			full;			// 1 if a note did not fit
+} ENCODE_Type;
 
 /*	
- *	rtttlDecode() is a common entry method for decoding received RTTTL messages. 
- *	It calls the 3 main methods that are part of the decode process. It also 
- *	outputs the name of the received song to the LCD. When the song has been
- *	played, it resets some variables and sets the arrays to 0. 
+ *	addNote() adds a note to the ringtone being compiled, as its note number 
+ *	and its duration in milliseconds at the current defaults. Notes past the 
+ *	room in the ringtone are dropped.
  *	
- *	@param	str[]		The string received
+ *	@param	pitch		0 for a pause, 1-12 for C to B
+ *	@param	octave		The octave of the note
+ *	@param	dur			The duration, eg 8 for a quaver
+ *	@param	dot			1 if the note is dotted, 0 otherwise
  */
-void rtttlDecode(char str[])
+void addNote(int pitch, int octave, int dur, int dot)
 {
-	sineSetup();
-	rtttlSplit(str);
-	
-	clear_screen();
-	put_mult_char_lcd("Playing", 1, 1);
-	put_mult_char_lcd(name, 1, 2);
-	
-	rtttlDefaults(str);
-	rtttlData(str);
-	clear_screen();
+	if(tone->count >= notes) return;
 	
-	ddur = 0;
-	doct = 0;
-	dbpm = 0;
-	k = 0;
-	x = 0;
-	
-	memset(name,0, sizeof(name));
-	memset(defaults,0, sizeof(defaults));
-	memset(data,0, sizeof(data));
-	memset(freq,0, sizeof(freq));
-	memset(dura,0, sizeof(dura));
+	tone->events[tone->count].note = toneNote(pitch, octave);
+	tone->events[tone->count].ticks = toneTicks(dur, dot, ddur, dbpm);
+	tone->count++;
 }
 
 /*	
- *	rtttlSplit() scans through the input string until the colon delimiters 
- *	are found. 
- *	 - The data before the 1st colon is stored in the name array. The RTTTL 
- *	   specification sets a maximum name length of 10 characters, but the 
- *	   implementation below can handle up to 32.
- *	 - The data between the 1st and 2nd colons contains the default duration, 
- *	   ocatve and bpm (beats per minute) values.
- *	 - The data after the 2nd colon is the main musical data. This is stored 
- *     in the data array. A comma is added to the end of this data to allow 
- *	   the rtttlData() method to detect the final value.
+ *	rtttlNote() is called by the RTTTL parser for each note it reads. The 
+ *	defaults are complete by the time the first note is read.
  *	
- *	@param	str[]		The string received
+ *	@param	p			The parser
+ *	@param	pitch		0 for a pause, 1-12 for C to B
+ *	@param	octave		The octave of the note
+ *	@param	dur			The duration, eg 8 for a quaver
+ *	@param	dot			1 if the note is dotted, 0 otherwise
  */
-void rtttlSplit(char str[])
+static void rtttlNote(RTTTL_PARSER *p, int pitch, int octave, int dur, int dot)
 {
-	int i=0,j=0;		// i input string and name index, j defaults index
-	
-	while(str[i] != ':')	
-	{
-		name[i] = str[i];
-		i++;
-	}
+	ddur = p->dur;
+	dbpm = p->bpm;
+	addNote(pitch, octave, dur, dot);
+}
 
+/*	
+ *	rtttlPrint() prints the name and defaults of a parsed ringtone to the 
+ *	terminal.
+ *	
+ *	@param	p			The parser, at the end of the ringtone
+ */
+static void rtttlPrint(RTTTL_PARSER *p)
+{
 	write_usb_serial_blocking(" Name:     ",11);
-	UARTPuts((LPC_UART_TypeDef *)LPC_UART0, name);
-	i++;
-
-	while(str[i] != ':')	
-	{	
-		defaults[j] = str[i];
-		j++;
-		i++;
-	}
-
-	defaults[j] = ',';
-	j++;
-
-	write_usb_serial_blocking("\n\r Defaults: ",15);
-	UARTPuts((LPC_UART_TypeDef *)LPC_UART0, defaults);
-	i++;
-
-	
-	while(str[i] != '\0')
-	{
-		data[k] = str[i];
-		k++;					// k has been made global for access by rtttlData()
-		i++;
-	}
-	
-	data[k] = ',';
-	k++;
-
-	write_usb_serial_blocking("\n\r Data:     ",15);
-	UARTPuts((LPC_UART_TypeDef *)LPC_UART0, data);
+	UARTPuts((LPC_UART_TypeDef *)LPC_UART0, p->name);
+	write_usb_serial_blocking("\n\r",2);
+	write_usb_serial_blocking(" Default Duration: \t",21);
+	UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, p->dur);
+	write_usb_serial_blocking("\n\r",2);
+	write_usb_serial_blocking(" Default Octave: \t",19);
+	UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, p->oct);
+	write_usb_serial_blocking("\n\r",2);
+	write_usb_serial_blocking(" Default BPM:   \t",18);
+	UARTPutDec16((LPC_UART_TypeDef *)LPC_UART0, p->bpm);
+	write_usb_serial_blocking("\n\r",2);
+	write_usb_serial_blocking(" Notes:    ",11);
+	UARTPutDec16((LPC_UART_TypeDef *)LPC_UART0, p->count);
+	write_usb_serial_blocking("\n\r",2);
 }
 
 /*	
- *	rtttlDefaults() parses the string containing the default values for the 
- *	RTTTL song being parsed. It is a specialised method for the RTTTL 
- *	defaults specification. It iterates through the string using the commas 
- *	as delimiters. This implementation can deal with spaces between the values.
+ *	rtttlDecode() is a common entry method for playing RTTTL messages, received 
+ *	or from the menu. If the string has been played before its notes are taken 
+ *	from the ringtone cache. Otherwise it is compiled by the RTTTL parser into 
+ *	a new cache entry, with room for a note per comma. The song is then played 
+ *	by rtttlPlay().
  *	
- *	@param	str[]		The string containing the default values
+ *	@param	str[]		The string received
  */
-void rtttlDefaults(char str[])
+void rtttlDecode(char str[])
 {
-	int p = 0;
+	int len = strlen(str);
+	uint32_t hash = toneHash((uint8_t*)str, len);
+	RTTTL_PARSER parser;
+	int commas = 0;
+	int p;
 	
-	while(defaults[p] != ',')
+	STACK_BEGIN(STACK_MUSIC);
+	seqStop(VOICE_TUNE);				// The ringtone playing may be replaced in the cache
+	tone = toneFind(hash);
+	if(tone)
 	{
-		if(digit(defaults[p]) && ddur == 0)
-		{
-			ddur = (int)defaults[p]-48;
-		}
-		else if(digit(defaults[p]) && ddur != 0)
-		{
-			ddur = (ddur*10) + (int)defaults[p]-48;
-		}
-		p++;
+		write_usb_serial_blocking(" Cached:   ",11);
+		UARTPuts((LPC_UART_TypeDef *)LPC_UART0, tone->name);
+		write_usb_serial_blocking("\n\r",2);
 	}
-	p++;
-	
-	while(defaults[p] != ',')
+	else
 	{
-		if(digit(defaults[p]) && doct == 0)
-		{
-			doct = (int)defaults[p]-48;
-		}
-		p++;
-	}
-	p++;
-	
-	while(defaults[p] != ',')
-	{		
-		if(digit(defaults[p]) && dbpm == 0)
-		{
-			dbpm = (int)defaults[p]-48;
-		}
-		else if(digit(defaults[p]) && dbpm < 10)
+		for(p=0; p<len; p++) if(str[p] == ',') commas++;
+		notes = commas+1;
+		tone = toneNew(hash, notes);
+		if(tone)
 		{
-			dbpm = (dbpm*10) + (int)defaults[p]-48;
-		}
-		else if(digit(defaults[p]) && dbpm < 100)
-		{
-			dbpm = (dbpm*10) + (int)defaults[p]-48;
+			rtttlInit(&parser, rtttlNote, 0);
+			rtttlFeed(&parser, str, len);
+			if(rtttlEnd(&parser) < 0)
+			{
+				write_usb_serial_blocking("Not an RTTTL ringtone\n\r",23);
+				toneDrop(tone);
+				tone = 0;
+			}
+			else
+			{
+				strcpy(tone->name, parser.name);
+				rtttlPrint(&parser);
+			}
+			ddur = dbpm = notes = 0;
 		}
-		p++;
+		else write_usb_serial_blocking("Ringtone too long\n\r",21);
 	}
 	
-	write_usb_serial_blocking("\n\r",4);
-	write_usb_serial_blocking(" Default Duration: \t",21);
-	UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, ddur);
-	write_usb_serial_blocking("\n\r",4);
-	write_usb_serial_blocking(" Default Octave: \t",19);
-	UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, doct);
-	write_usb_serial_blocking("\n\r",4);
-	write_usb_serial_blocking(" Default BPM:   \t",18);
-	UARTPutDec16((LPC_UART_TypeDef *)LPC_UART0, dbpm);
-	write_usb_serial_blocking("\n\r",4);
-
+	if(tone) rtttlPlay();
+	tone = 0;
+	STACK_END(STACK_MUSIC);
 }
 
 /*	
- *	rtttlData() is a large method which parses the data string to produce 
- *	note frequencies in Hertz and durations in seconds.
- *
- *	For each character in the array, if it is not a comma, parse it as described 
- *	inline. Hashed notes are assigned to a character with an ASCII code 7 greater 
- *	than the standard note.
+ *	notesDecode() is the entry method for ringtones received as a binary note 
+ *	stream (see rtttlEncode()) rather than as RTTTL text. There is no text to 
+ *	parse: each note byte gives the frequency and duration directly, which 
+ *	are compiled into note events, cached and played as for RTTTL.
  *	
- *	If a comma is found, assume that the end of the individual note description 
- *	has been found. If the duration and octave value for the note are empty, 
- *	assign the default values to it.
- *
- *	The actual frequency of the note is calculated by passing the note and octave 
- *	to music() and storing the resulting value in freq[], similarly for dur[]. Then
- *	the arrays and variables are reset and the process begins again for the next note.
- *
- *	Once finished, the value or freq[] and dur[] are printed to the terminal. Then 
- *	each note-duration pair is sent to play() to be played. When this is finished, 
- *	the DMA channel is turned off the stop the DAC outputting to the speaker.
+ *	The stream comes from the network, and the checksum is optional, so a 
+ *	header with a duration code, octave or BPM outside the specification is 
+ *	refused, as is a stream with no notes.
  *	
- *	@param	str[]		The string containing the RTTTL data
+ *	@param	str[]		The note stream received
+ *	@param	len			The number of bytes in the note stream
  */
-void rtttlData(char str[])
-{	
-	int q = 0;				// A counter
-	char val;				// The note value
-	int dot = 0;			// Flag to indicate a dotted note
-	char msbDur = '0';		// Holds the most significant bit of a duration, eg 3 in 32
-	char tmparray[3] = {'0','0','0'}; // [duration, note, octave]
+void notesDecode(uint8_t str[], int len)
+{
+	int n = str[0];				// Name length
+	uint32_t hash;
+	int p = 0;
+	int oct, bpm;
+	
+	if(len < n+4)
+	{
+		write_usb_serial_blocking("Note stream too short\n\r",24);
+		return;
+	}
+	oct = str[n+1] & 0x0F;
+	bpm = str[n+2] | (str[n+3] << 8);
+	if((str[n+1] >> 4) >= NOTE_DURS || oct < RTTTL_OCT_MIN || oct > RTTTL_OCT_MAX || 
+		bpm < RTTTL_BPM_MIN || bpm > RTTTL_BPM_MAX)
+	{
+		write_usb_serial_blocking("Bad note stream header\n\r",24);
+		return;
+	}
+	if(len == n+4)
+	{
+		write_usb_serial_blocking("Ringtone has no notes\n\r",23);
+		return;
+	}
 	
-	for(q=0; q<k; q++)
+	hash = toneHash(str, len);
+	seqStop(VOICE_TUNE);				// The ringtone playing may be replaced in the cache
+	tone = toneFind(hash);
+	if(tone == 0)
 	{
-		val = data[q];
-		if(val != ',')
+		notes = len-n-4;						// At most one note per byte
+		tone = toneNew(hash, notes);
+		if(tone == 0)
 		{
-			// If the current character is a digit and following is a letter, assume duration
-			if(digit(val) && letter(data[q+1]))	
-			{			
-				tmparray[0] = val;
-			}
-			// If the current character is a digit and following is a digit, assume 2 digit duration
-			else if(digit(val) && digit(data[q+1]))
-			{
-				msbDur = val;
-			}
-			// If the current character is a letter, assume note
-			else if(letter(val))
-			{
-				tmparray[1] = val;
-			}
-			// If the current character is a digit, assume octave
-			else if(digit(val))
-			{
-				tmparray[2] = val;
-			}
-			else if(val == '#')
-			{
-				tmparray[1] = tmparray[1] + 7;
-			}
-			else if(val == '.')
-			{
-				dot = 1;
-			}
+			write_usb_serial_blocking("Ringtone too long\n\r",21);
+			return;
 		}
 		
-		else if(val == ',')
+		for(p=0; p<n && p<TONE_NAME-1; p++) tone->name[p] = str[p+1];
+		tone->name[p] = '\0';
+		ddur = noteDurations[str[n+1] >> 4];
+		doct = oct;
+		dbpm = bpm;
+		
+		oct = doct;
+		for(p=n+4; p<len; p++)
 		{
-			if(tmparray[2] == '0')
-			{
-				tmparray[2] = (char)doct+48;		
-			}
-			if(tmparray[0] == '0')
+			if((str[p] >> 4) == NOTE_OCTAVE)	// Octave change for the notes that follow
 			{
-				tmparray[0] = (char)ddur+48;		
+				oct = str[p] & 0x0F;
+				continue;
 			}
-			
-			if(msbDur != '0') UARTPutChar((LPC_UART_TypeDef *)LPC_UART0, msbDur);
-			UARTPutChar((LPC_UART_TypeDef *)LPC_UART0, tmparray[0]);
-			UARTPutChar((LPC_UART_TypeDef *)LPC_UART0, tmparray[1]);
-			UARTPutChar((LPC_UART_TypeDef *)LPC_UART0, tmparray[2]);
-			write_usb_serial_blocking(" ",1);
-			
-			freq[x] = music(tmparray[1],(int)tmparray[2]-48);
-			dura[x] = duration((int)tmparray[0]-48,dot,(int)msbDur-48);	
-			x++;
-			
-			tmparray[0] = '0';
-			tmparray[1] = '0';
-			tmparray[2] = '0';
-			dot = 0;
-			msbDur = '0';
+			if((str[p] >> 4) > 12) continue;	// Not a pitch, ignore it
+			addNote(str[p] >> 4, oct, noteDurations[(str[p] >> 1) & 0x07], str[p] & 0x01);
 		}
+		
+		ddur = doct = dbpm = notes = 0;
 	}
 	
-	write_usb_serial_blocking("\n\rFrequency array values: \n\r",32);
-	for(q=0; q<x; q++)
+	rtttlPlay();
+	tone = 0;
+}
+
+/*	
+ *	rtttlPlay() shows the name of the ringtone on the LCD, or its title if it 
+ *	is one of the library's (see ringtones.c), prints its note events to the 
+ *	terminal, then starts the sequencer (see seq.c) playing them. It returns 
+ *	as soon as the first note has started, and the song plays on from the 
+ *	timer interrupt. The name is kept for rtttlName().
+ */
+void rtttlPlay()
+{
+	int q = 0;				// A counter
+	int lib = ringtoneFind(tone->name);
+	const char *name = (lib >= 0) ? ringtones[lib].title : tone->name;
+	
+	for(q=0; q<16 && name[q]; q++) playName[q] = name[q];
+	playName[q] = '\0';
+	clear_screen();
+	put_mult_char_lcd("Playing", 1, 1);
+	put_mult_char_lcd(playName, 1, 2);
+	
+	write_usb_serial_blocking("\n\rNote values: \n\r",19);
+	for(q=0; q<tone->count; q++)
 	{
 		write_usb_serial_blocking(" ",1);
-		UARTPutDec32((LPC_UART_TypeDef *)LPC_UART0, freq[q]*100);	
+		UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, tone->events[q].note);	
 	}	
 	
-	write_usb_serial_blocking("\n\rDuration array values: \n\r",28);
-	for(q=0; q<x; q++)
+	write_usb_serial_blocking("\n\rDuration values: \n\r",23);
+	for(q=0; q<tone->count; q++)
 	{
 		write_usb_serial_blocking(" ",1);
-		UARTPutDec32((LPC_UART_TypeDef *)LPC_UART0, dura[q]*100);	
+		UARTPutDec16((LPC_UART_TypeDef *)LPC_UART0, tone->events[q].ticks);	
 	}		
 	write_usb_serial_blocking("\n\r",4);
 
-	for(q=0;q<x;q++)	
+	synthGain(VOICE_TUNE, SYNTH_GAIN);
+	synthShape(VOICE_TUNE, toneShape);
+	synthEnvelope(VOICE_TUNE, SYNTH_PIANO);
+	seqStart(VOICE_TUNE, tone->events, tone->count);
+}
+
+/*	
+ *	rtttlName() gives the name rtttlPlay() showed for the ringtone playing, 
+ *	so a screen drawn while it plays can show it again.
+ *	
+ *	@return				The name, or 0 if no ringtone is playing
+ */
+const char* rtttlName(void)
+{
+	if(seqStatus(VOICE_TUNE, 0) != SEQ_PLAYING) return 0;
+	return playName;
+}
+
+/*	
+ *	encodeNote() is called by the RTTTL parser for each note rtttlEncode() 
+ *	reads, and adds it to the note stream, after an octave change if it is 
+ *	in a different octave to the note before. The notes start after the 
+ *	name and defaults, which are written at the end.
+ *	
+ *	@param	p			The parser, with the ENCODE_Type in p->ctx
+ *	@param	pitch		0 for a pause, 1-12 for C to B
+ *	@param	octave		The octave of the note
+ *	@param	dur			The duration, eg 8 for a quaver
+ *	@param	dot			1 if the note is dotted, 0 otherwise
+ */
+static void encodeNote(RTTTL_PARSER *p, int pitch, int octave, int dur, int dot)
+{
+	ENCODE_Type *e = p->ctx;
+	int code;
+	
+	if(e->len == 0)
+	{
+		e->len = strlen(p->name)+4;		// The defaults are complete by the first note
+		e->oct = p->oct;
+	}
+	for(code=0; code<5 && noteDurations[code] != dur; code++);
+	
+	if(pitch != 0 && octave != e->oct)
 	{
-		play(freq[q],dura[q]);	// Play each note-duration pair
+		if(e->len >= e->size) e->full = 1;
+		if(e->full) return;
+		e->out[e->len++] = (NOTE_OCTAVE << 4) | (octave & 0x0F);
+		e->oct = octave;
 	}
+	if(e->len >= e->size) e->full = 1;
+	if(e->full) return;
+	e->out[e->len++] = (pitch << 4) | (code << 1) | dot;
+}
+
+/*	
+ *	rtttlEncode() converts an RTTTL string into the binary note stream used to 
+ *	send ringtones over the network, which is about a quarter of the size and 
+ *	needs no parsing by the receiver. The stream is laid out as:
+ *	 - 1 byte name length n, followed by the n name characters
+ *	 - 1 byte of defaults, the default duration code in the top 4 bits and 
+ *	   the default octave in the bottom 4 bits
+ *	 - 2 bytes of BPM, least significant byte first
+ *	 - 1 byte per note: the pitch in the top 4 bits (0 for a pause, 1-12 for 
+ *	   C to B), the duration code in bits 3-1 (0-5 for 1, 2, 4, 8, 16 and 32) 
+ *	   and the dot in bit 0
+ *	 - a note byte with a pitch of NOTE_OCTAVE sets the octave, in its bottom 
+ *	   4 bits, for the notes that follow. Notes start at the default octave.
+ *	
+ *	The string is read by the parser in rtttl.c, so it is read the same way 
+ *	as when it is played.
+ *	
+ *	@param	str[]		The RTTTL string
+ *	@param	out[]		The array to write the note stream to
+ *	@param	size		The size of out[]
+ *	@return				The length of the note stream, 0 if it did not fit
+ */
+int rtttlEncode(char str[], uint8_t out[], int size)
+{
+	RTTTL_PARSER parser;
+	ENCODE_Type e;
+	int n, code;
+	
+	e.out = out;
+	e.size = size;
+	e.len = 0;
+	e.full = 0;
+	rtttlInit(&parser, encodeNote, &e);
+	rtttlFeed(&parser, str, strlen(str));
+	if(rtttlEnd(&parser) < 0) return 0;
 	
-	GPDMA_ChannelCmd(0, DISABLE);
+	n = strlen(parser.name);
+	if(e.full || size < n+4) return 0;
+	if(e.len == 0) e.len = n+4;			// No notes
 	
-	write_usb_serial_blocking("\n\rFinished playing \n\r",24);
+	out[0] = n;
+	memcpy(&out[1], parser.name, n);
+	for(code=0; code<5 && noteDurations[code] != parser.dur; code++);
+	out[n+1] = (code << 4) | (parser.oct & 0x0F);
+	out[n+2] = parser.bpm;
+	out[n+3] = parser.bpm >> 8;
+	
+	return e.len;
 }
 
 /*	
@@ -350,155 +417,90 @@ int digit(char test)
 }
 
 /*	
- *	music() provides the frequency in Hertz of the note that was parsed 
- *	from the RTTTL input string. For hashed notes (eg C#) they have 
- *	been assigned a character with an ASCII code 7 higher than the base 
- *	note (eg C) in rtttlData().
+ *	play() plays a single note and waits for it to finish, for morse code, 
+ *	which is played a note at a time. Ringtones are played by rtttlPlay() 
+ *	without waiting.
  *	
- *	@param	note		The note for which a frequency needs to be assigned
- *	@param	octave		The octave of the note
- *	@return	value		The frequency value of the requested note
+ *	@param	note			The note number of the note to be played (see 
+ *							toneNote()), 0 for a pause
+ *	@param	duration		The duration in milliseconds of the note
  */
-float music(char note, int octave)
+void play(uint16_t note, uint16_t duration)
 {
-	float value = 0;
+	static NOTE_EVENT event;		// Read by the sequencer as it plays
 	
-	switch(tolower((int)note))		// Frequency value in Hz for 4th octave
+	event.note = note;
+	event.ticks = duration;
+	synthGain(VOICE_TUNE, SYNTH_GAIN);
+	synthShape(VOICE_TUNE, SYNTH_SINE);
+	synthEnvelope(VOICE_TUNE, SYNTH_ORGAN);	// Morse beeps start and stop sharply
+	seqStart(VOICE_TUNE, &event, 1);
+	while(seqStatus(VOICE_TUNE, 0) == SEQ_PLAYING)
 	{
-		case 'c':
-			value = 261.63;
-			break;
-		case 'j':		//C#
-			value = 277.18;
-			break;
-		case 'd':
-			value = 293.66;
-			break;
-		case 'k':		//D#
-			value = 311.13;
-			break;
-		case 'e':
-			value = 329.63;
-			break;
-		case 'f':
-			value = 349.23;
-			break;
-		case 'm':		//F#
-			value = 369.99;
-			break;
-		case 'g':
-			value = 392.00;
-			break;
-		case 'n':		//G#
-			value = 415.30;
-			break;
-		case 'a':
-			value = 440.00;
-			break;
-		case 'h':		//A#
-			value = 466.16;
-			break;
-		case 'b':
-			value = 493.88;
-			break;
-		case 'p':
-			value = 0.00;
-			break;
-		default:
-			value = 0.00;
-			break;
+		__WFI();					// Sleep until the next interrupt
 	}
-	
-	if(octave == 5) value = value * 2;
-	else if(octave == 6) value = value * 4;
-	else if(octave == 7) value = value * 8;
-	
-	return value;
-}
-
-/*	
- *	duration() calculates the duration that the notes is required to be 
- *	played for in seconds. From the default beats per minute, it first 
- *	calculates the time in seconds each default beat is played for. Then 
- *	the duration of the current note is calculated using a formula, if 
- *	dotted this is multiplied by 1.5. 
- *	
- *	@param	dur			The raw duration value parsed from the input string
- *	@param	dot			1 if the note is dotted, 0 otherwise
- *	@param	msb			1 or 3 if the duration was 16 or 32 respectively
- *	@return	value		The duration value of the requested note in milliseconds
- */
-float duration(int dur, int dot, int msb)
-{	
-	float blockTime = 1.0/(((float)dbpm)/60.0);
-	float value = 0;
-	int localDur;
-	
-	if(msb != 0)		localDur = (msb*10)+dur;
-	else localDur = dur;
-	
-	value = ((float)ddur/(float)localDur)*blockTime;
-	
-	if(dot == 1)		value = value*1.5;
-	
-	return value*1000;
 }
 
 /*	
- *	play() receives a note-duration pair. It sets the timer match value to 
- *	the duration and if the note value is not 0, enables the timer and plays 
- *	the note will the interrupt flag isn't set. 
- *
- *	When it is set, the program control exits the while loop, clears the 
- *	interrupt, turns off the timer and returns to the for each loop where 
- *	the next note value is sent here. If the note value is 0, the DMA channel 
- *	is turned off for the specified time.
+ *	chord() plays up to CHORD_NOTES notes together over the ringtone playing, 
+ *	on the synthesiser voices ringtones do not use, and returns straight 
+ *	away. Each is played at a quarter of full volume, so the chord does not 
+ *	drown the ringtone; the mix is clipped where they peak together.
  *	
- *	@param	note			The frequency in Hertz of the note to be played
- *	@param	duration		The duration in milliseconds of the note
+ *	@param	notes[]			The note numbers (see toneNote())
+ *	@param	n				The number of notes
+ *	@param	duration		The duration in milliseconds of the chord
  */
-void play(float note, float duration)
+void chord(const uint16_t notes[], int n, uint16_t duration)
 {
-	Timer0.PrescaleOption = TIM_PRESCALE_USVAL;	// Prescale in microsecond value
-	Timer0.PrescaleValue = 1000;				// 1000 us = 1 ms
-	
-	Match0.MatchChannel = 0;			// Match channel 0
-	Match0.IntOnMatch = ENABLE;			// Interrupt on match
-	Match0.StopOnMatch = ENABLE;		// Stop on match
-	Match0.ResetOnMatch = ENABLE;		// Reset on match
-	Match0.ExtMatchOutputType = TIM_EXTMATCH_NOTHING;// Do nothing to external output pin when match
-	Match0.MatchValue = (int)duration;
-	
-	TIM_Init(LPC_TIM0, TIM_TIMER_MODE, &Timer0);
-	TIM_ConfigMatch(LPC_TIM0, &Match0);	
-	TIM_Cmd(LPC_TIM0, ENABLE);
+	static NOTE_EVENT events[CHORD_NOTES];	// Read by the sequencer as they play
+	int v;
 	
-	if(note == 0.00)
+	for(v=0; v<CHORD_NOTES; v++)
 	{
-		GPDMA_ChannelCmd(0, DISABLE);
-		while(TIM_GetIntStatus(LPC_TIM0, TIM_MR0_INT) != SET)
-		{
-			//wait
-		}
-		GPDMA_ChannelCmd(0, ENABLE);
-	}
-	else
-	{	
-		if(prevNote == note)
+		if(v < n)
 		{
-			GPDMA_ChannelCmd(0, DISABLE);
-			delay(50);
+			events[v].note = notes[v];
+			events[v].ticks = duration;
+			synthGain(VOICE_CHORD+v, SYNTH_GAIN/4);
+			seqStart(VOICE_CHORD+v, &events[v], 1);
 		}
-		GPDMA_ChannelCmd(0, ENABLE);
-		while(TIM_GetIntStatus(LPC_TIM0, TIM_MR0_INT) != SET)
+		else
 		{
-			sine(note);
+			seqStop(VOICE_CHORD+v);
 		}
-	
 	}
-	prevNote = note;
+}
 
-	TIM_ClearIntPending(LPC_TIM0, TIM_MR0_INT);
-	TIM_Cmd(LPC_TIM0, DISABLE);
+/*	
+ *	notify() plays a short rising chime, C major then F major, over 
+ *	whatever is playing, to say a message has arrived. It returns straight 
+ *	away.
+ */
+void notify(void)
+{
+	static const NOTE_EVENT chime[CHORD_NOTES][2] = {
+		{{25, 120}, {30, 240}},		// C6, F6
+		{{29, 120}, {34, 240}},		// E6, A6
+		{{32, 120}, {37, 240}},		// G6, C7
+	};
+	int v;
+	
+	for(v=0; v<CHORD_NOTES; v++)
+	{
+		synthGain(VOICE_CHORD+v, SYNTH_GAIN/4);
+		seqStart(VOICE_CHORD+v, chime[v], 2);
+	}
 }
 
+/*	
+ *	nextShape() moves ringtones on to the next wave shape: sine, square, 
+ *	triangle then saw.
+ *	
+ *	@return				The name of the new shape
+ */
+const char* nextShape(void)
+{
+	toneShape = (toneShape+1) % SYNTH_SHAPES;
+	return shapeNames[toneShape];
+}
@@ -2,13 +2,23 @@
  *	@author		abradbury
  */
 
+#define NOTE_OCTAVE		0x0F	// Note stream pitch value that sets the octave
+#define NOTE_DURS		6		// Note stream duration codes in use, 0-5
+
+#define VOICE_TUNE		0		// Synthesiser voice of ringtones and morse code
+#define VOICE_CHORD		1		// First of the voices for chords over the ringtone
+#define CHORD_NOTES		3		// Voices for chords, VOICE_CHORD onwards
+
+void addNote(int pitch, int octave, int dur, int dot);
 void rtttlDecode(char str[]);
-void rtttlSplit(char str[]);
-void rtttlDefaults(char str[]);
-void rtttlData(char str[]);
+void notesDecode(uint8_t str[], int len);
+int rtttlEncode(char str[], uint8_t out[], int size);
+void rtttlPlay();
+const char* rtttlName(void);
 int between(char low, char high, char check);
 int letter(char test);
 int digit(char test);
-float music(char note, int octave);
-float duration(int dur, int dot, int msb);
-void play(float note, float duration);
+void play(uint16_t note, uint16_t duration);
+void chord(const uint16_t notes[], int n, uint16_t duration);
+void notify(void);
+const char* nextShape(void);
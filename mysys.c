@@ -1,125 +1,416 @@
-/*	
+/*
  *	@author		P. Cooper
- * 
+ *
  *	mysys.c is a memory allocation routine to replace malloc, courtesy of P. Cooper.
- *	Malloc uses memory allocated in the CPU for the USB and Network buffers, these memory pointers 
+ *	Malloc uses memory allocated in the CPU for the USB and Network buffers, these memory pointers
  *	can not be changed, so this code will not work if either of these features are used.
  *
+ *	The original bump allocator, which scanned the whole heap to compact it when the
+ *	free region ran out, has been replaced with a two-level segregated fit (TLSF)
+ *	allocator. Free blocks are kept in lists by size class; the first level splits
+ *	sizes by power of two and the second level splits each power of two into
+ *	SL_COUNT linear steps. A bitmap per level means a suitable list is found with
+ *	two bit scans, so MSYS_Alloc() and MSYS_Free() take constant time however many
+ *	blocks are live. Freed blocks are merged with free neighbours straight away, so
+ *	MSYS_Compact() no longer has anything to do.
+ *
+ *	Building with MSYS_STATS defined adds heap instrumentation: bytes in use and
+ *	the peak, allocation and failure counts, frees of pointers that are not live
+ *	blocks, and a table of live allocations by call site (MSYS_Alloc() becomes a
+ *	macro passing __FILE__ and __LINE__). MSYS_Stats() fills in the figures and
+ *	MSYS_Dump() prints them. Without MSYS_STATS none of this is compiled in.
+ *
+ *	MSYS_Alloc() and MSYS_Free() may be called from interrupt handlers. The free
+ *	list work is done with interrupts masked (PRIMASK is saved and restored, so
+ *	the calls nest inside other critical sections). Without MSYS_STATS neither
+ *	call loops (the bit scans are single instructions on the Cortex-M3), so the
+ *	time interrupts are held off is bounded. The figures that follow are
+ *	estimates from the instruction count and have not been measured on the
+ *	LPC1768, which could be done with the DWT cycle counter: the worst case is
+ *	about 120 cycles for an allocation that splits a block and about 100 for a
+ *	free that merges both neighbours at -O2, and roughly three times that at the
+ *	-O0 the Makefile builds with (about 4 us at 100 MHz).
+ *
+ *	With MSYS_STATS defined this no longer holds. MSYS_Alloc() looks its call
+ *	site up with site(), a loop over up to MSYS_SITES entries with interrupts
+ *	masked, and MSYS_Stats() walks the whole heap with interrupts masked, so
+ *	an instrumented build should not be used where interrupt latency matters.
+ *	On a host build the masking compiles to nothing.
+ *
  */
 
-#define USED 1
+#include <stddef.h>
+#include "mysys.h"
 
-typedef struct {
-  unsigned size;
-} UNIT;
+#ifdef MSYS_STATS
+#include <stdio.h>
+#include <string.h>
+#undef MSYS_Alloc
+#endif
+
+#define USED      1                         /* low bit of size, set when the block is allocated */
+
+#define SL_LOG2   4                         /* second level lists per power of two, as a log2 */
+#define SL_COUNT  ( 1 << SL_LOG2 )
+#define FL_SHIFT  ( SL_LOG2 + 3 )           /* sizes below 1 << FL_SHIFT all go in first level 0 */
+#define FL_MAX    24                        /* largest block is just under 1 << FL_MAX bytes */
+#define FL_COUNT  ( FL_MAX - FL_SHIFT + 1 )
+#define SMALL     ( 1 << FL_SHIFT )
+
+#define ALIGN     sizeof(void *)
+
+typedef struct BLOCK {
+  struct BLOCK *prev;                       /* previous block in memory, 0 for the first */
+  unsigned size;                            /* size including this header, low bit is USED */
+#ifdef MSYS_STATS
+  unsigned site;                            /* index in the call site table of the allocator */
+#endif
+  struct BLOCK *next_free;                  /* free list links, only valid while free, */
+  struct BLOCK *prev_free;                  /* the user data starts here when allocated */
+} BLOCK;
+
+#define HEADER    offsetof( BLOCK, next_free )
+#define MIN_BLOCK sizeof(BLOCK)
 
 typedef struct {
-  UNIT* free;
-  UNIT* heap;
+  char *start;                              /* first block in the heap */
+  char *end;                                /* the sentinel block that ends the heap */
+  unsigned fl_bitmap;                       /* bit set for each first level with a free block */
+  unsigned sl_bitmap[FL_COUNT];             /* bit set for each second level list with a free block */
+  BLOCK *blocks[FL_COUNT][SL_COUNT];        /* the free lists */
+#ifdef MSYS_STATS
+  MSYS_STATS_Type stats;
+  MSYS_SITE_Type sites[MSYS_SITES + 1];     /* the last entry collects sites that did not fit */
+#endif
 } MSYS;
 
 static MSYS msys;
 
-static UNIT* compact( UNIT *p, unsigned nsize )
+#if defined( __arm__ )
+static inline unsigned lock( void )
 {
-       unsigned bsize, psize;
-       UNIT *best;
+       unsigned mask;
+       __asm volatile( "mrs %0, primask\n\tcpsid i" : "=r"( mask ) : : "memory" );
+       return mask;
+}
+
+static inline void unlock( unsigned mask )
+{
+       __asm volatile( "msr primask, %0" : : "r"( mask ) : "memory" );
+}
+#else
+static inline unsigned lock( void ) { return 0; }
+static inline void unlock( unsigned mask ) { (void)mask; }
+#endif
+
+#define BSIZE(b)  ( (b)->size & ~USED )
+#define NEXT(b)   ( (BLOCK *)( (char *)(b) + BSIZE(b) ) )
 
-       best = p;
-       bsize = 0;
+static int bit_last( unsigned x )
+{
+       return 31 - __builtin_clz( x );
+}
+
+static int bit_first( unsigned x )
+{
+       return __builtin_ctz( x );
+}
 
-       while( psize = p->size, psize )
+/*
+ *	mapping() finds the list a block of the given size belongs in.
+ */
+static void mapping( unsigned size, int *fl, int *sl )
+{
+       if( size < SMALL )
+       {
+           *fl = 0;
+           *sl = size / ( SMALL / SL_COUNT );
+       }
+       else
        {
-              if( psize & USED )
-              {
-                  if( bsize != 0 )
-                  {
-                      best->size = bsize;
-                      if( bsize >= nsize )
-                      {
-                          return best;
-                      }
-                  }
-                  bsize = 0;
-                  best = p = (UNIT *)( (unsigned)p + (psize & ~USED) );
-              }
-              else
-              {
-                  bsize += psize;
-                  p = (UNIT *)( (unsigned)p + psize );
-              }
+           int f = bit_last( size );
+           *sl = ( size >> ( f - SL_LOG2 ) ) ^ SL_COUNT;
+           *fl = f - FL_SHIFT + 1;
        }
+}
+
+static void list_insert( BLOCK *b )
+{
+       int fl, sl;
+
+       mapping( BSIZE(b), &fl, &sl );
+       b->prev_free = 0;
+       b->next_free = msys.blocks[fl][sl];
+       if( b->next_free ) b->next_free->prev_free = b;
+       msys.blocks[fl][sl] = b;
+       msys.fl_bitmap |= 1U << fl;
+       msys.sl_bitmap[fl] |= 1U << sl;
+}
+
+static void list_remove( BLOCK *b )
+{
+       int fl, sl;
 
-       if( bsize != 0 )
+       mapping( BSIZE(b), &fl, &sl );
+       if( b->next_free ) b->next_free->prev_free = b->prev_free;
+       if( b->prev_free ) b->prev_free->next_free = b->next_free;
+       else
        {
-           best->size = bsize;
-           if( bsize >= nsize )
+           msys.blocks[fl][sl] = b->next_free;
+           if( b->next_free == 0 )
            {
-               return best;
+               msys.sl_bitmap[fl] &= ~( 1U << sl );
+               if( msys.sl_bitmap[fl] == 0 ) msys.fl_bitmap &= ~( 1U << fl );
            }
        }
+}
+
+/*
+ *	find() returns a free block of at least size bytes, or 0. The size is rounded
+ *	up to the next list boundary first, so any block in the list found will do.
+ */
+static BLOCK *find( unsigned size )
+{
+       int fl, sl;
+       unsigned map;
+
+       if( size < SMALL ) size += SMALL / SL_COUNT - 1;
+       else size += ( 1U << ( bit_last( size ) - SL_LOG2 ) ) - 1;
+       mapping( size, &fl, &sl );
+       if( fl >= FL_COUNT ) return 0;
 
-       return 0;
+       map = msys.sl_bitmap[fl] & ( ~0U << sl );
+       if( map == 0 )
+       {
+           map = msys.fl_bitmap & ( ~0U << ( fl + 1 ) );
+           if( map == 0 ) return 0;
+           fl = bit_first( map );
+           map = msys.sl_bitmap[fl];
+       }
+       return msys.blocks[fl][bit_first( map )];
 }
 
 void MSYS_Free( void *ptr )
 {
-     if( ptr )
+     BLOCK *b, *n;
+     unsigned mask;
+
+     if( ptr == 0 ) return;
+     mask = lock();
+     if( (char *)ptr < msys.start + HEADER || (char *)ptr >= msys.end
+         || ( (size_t)ptr & ( ALIGN - 1 ) ) )
+     {
+#ifdef MSYS_STATS
+         msys.stats.bad_frees++;                /* not from this heap, eg a static buffer */
+#endif
+         unlock( mask );
+         return;
+     }
+
+     b = (BLOCK *)( (char *)ptr - HEADER );
+     if( !( b->size & USED ) )
      {
-         UNIT *p;
+#ifdef MSYS_STATS
+         msys.stats.bad_frees++;
+#endif
+         unlock( mask );
+         return;
+     }
+     b->size &= ~USED;
+#ifdef MSYS_STATS
+     msys.stats.used -= b->size;
+     msys.stats.frees++;
+     msys.sites[b->site].live--;
+     msys.sites[b->site].bytes -= b->size;
+#endif
 
-         p = (UNIT *)( (unsigned)ptr - sizeof(UNIT) );
-         p->size &= ~USED;
+     if( b->prev && !( b->prev->size & USED ) )
+     {
+         list_remove( b->prev );
+         b->prev->size += b->size;
+         b = b->prev;
      }
+     n = NEXT(b);
+     if( !( n->size & USED ) )
+     {
+         list_remove( n );
+         b->size += n->size;
+     }
+     NEXT(b)->prev = b;
+
+     list_insert( b );
+     unlock( mask );
 }
 
-void *MSYS_Alloc( unsigned size )
+#ifdef MSYS_STATS
+/*
+ *	site() returns the call site table entry for file and line, adding it if it
+ *	is new. The file names are the compiler's __FILE__ strings, so they can be
+ *	compared by pointer.
+ */
+static unsigned site( const char *file, int line )
 {
-     unsigned fsize;
-     UNIT *p;
+       unsigned i;
 
-     if( size == 0 ) return 0;
+       for( i = 0; i < MSYS_SITES && msys.sites[i].file; i++ )
+       {
+           if( msys.sites[i].file == file && msys.sites[i].line == line ) return i;
+       }
+       if( i == MSYS_SITES ) return MSYS_SITES;
+       msys.sites[i].file = file;
+       msys.sites[i].line = line;
+       return i;
+}
 
-     size  += 3 + sizeof(UNIT);
-     size >>= 2;
-     size <<= 2;
+void *MSYS_AllocAt( unsigned size, const char *file, int line )
+#else
+void *MSYS_Alloc( unsigned size )
+#endif
+{
+     unsigned bsize, mask;
+     BLOCK *b, *rest;
 
-     if( msys.free == 0 || size > msys.free->size )
+     mask = lock();
+#ifdef MSYS_STATS
+     msys.stats.allocs++;
+#endif
+     if( size == 0 || size >= ( 1U << FL_MAX ) ) b = 0;
+     else
      {
-         msys.free = compact( msys.heap, size );
-         if( msys.free == 0 ) return 0;
+         size  += HEADER + ALIGN - 1;
+         size  &= ~( ALIGN - 1 );
+         if( size < MIN_BLOCK ) size = MIN_BLOCK;
+         b = find( size );
      }
-
-     p = msys.free;
-     fsize = msys.free->size;
-
-     if( fsize >= size + sizeof(UNIT) )
+     if( b == 0 )
      {
-         msys.free = (UNIT *)( (unsigned)p + size );
-         msys.free->size = fsize - size;
+#ifdef MSYS_STATS
+         msys.stats.fails++;
+#endif
+         unlock( mask );
+         return 0;
      }
-     else
+     list_remove( b );
+
+     bsize = BSIZE(b);
+     if( bsize >= size + MIN_BLOCK )
      {
-         msys.free = 0;
-         size = fsize;
+         rest = (BLOCK *)( (char *)b + size );
+         rest->size = bsize - size;
+         rest->prev = b;
+         NEXT(rest)->prev = rest;
+         list_insert( rest );
+         bsize = size;
      }
 
-     p->size = size | USED;
+     b->size = bsize | USED;
+#ifdef MSYS_STATS
+     b->site = site( file, line );
+     msys.sites[b->site].live++;
+     msys.sites[b->site].bytes += bsize;
+     msys.stats.used += bsize;
+     if( msys.stats.used > msys.stats.peak ) msys.stats.peak = msys.stats.used;
+#endif
+     unlock( mask );
 
-     return (void *)( (unsigned)p + sizeof(UNIT) );
+     return (char *)b + HEADER;
 }
 
 void MSYS_Init( void *heap, unsigned len )
 {
-     len  += 3;
-     len >>= 2;
-     len <<= 2;
-     msys.free = msys.heap = (UNIT *) heap;
-     msys.free->size = msys.heap->size = len - sizeof(UNIT);
-     *(unsigned *)((char *)heap + len - 4) = 0;
+     char *start = (char *)heap;
+     BLOCK *b, *end;
+     int fl, sl;
+
+     while( (size_t)start & ( ALIGN - 1 ) ) start++, len--;
+     len &= ~( ALIGN - 1 );
+     if( len > ( 1U << FL_MAX ) - ALIGN ) len = ( 1U << FL_MAX ) - ALIGN;
+
+     msys.fl_bitmap = 0;
+     for( fl = 0; fl < FL_COUNT; fl++ )
+     {
+         msys.sl_bitmap[fl] = 0;
+         for( sl = 0; sl < SL_COUNT; sl++ ) msys.blocks[fl][sl] = 0;
+     }
+
+     /* one free block covering the heap, followed by a used sentinel header */
+     b = (BLOCK *)start;
+     b->prev = 0;
+     b->size = len - HEADER;
+     end = NEXT(b);
+     end->prev = b;
+     end->size = 0 | USED;
+
+     msys.start = start;
+     msys.end = (char *)end;
+     list_insert( b );
+
+#ifdef MSYS_STATS
+     memset( &msys.stats, 0, sizeof(msys.stats) );
+     memset( msys.sites, 0, sizeof(msys.sites) );
+     msys.sites[MSYS_SITES].file = "(other)";
+#endif
 }
 
 void MSYS_Compact( void )
 {
-     msys.free = compact( msys.heap, 0x7FFFFFFF );
+     /* free blocks are coalesced in MSYS_Free(), there is nothing left to do */
+}
+
+#ifdef MSYS_STATS
+/*
+ *	MSYS_Stats() fills in the heap figures. The free space figures come from a
+ *	walk of the whole heap, so this takes time in proportion to the number of
+ *	blocks and is not meant to be called in a hurry.
+ */
+void MSYS_Stats( MSYS_STATS_Type *stats )
+{
+     BLOCK *b;
+     unsigned mask;
+
+     mask = lock();
+     *stats = msys.stats;
+     stats->size = msys.end - msys.start;
+     stats->free = stats->largest = stats->blocks = 0;
+
+     for( b = (BLOCK *)msys.start; (char *)b < msys.end; b = NEXT(b) )
+     {
+         stats->blocks++;
+         if( b->size & USED ) continue;
+         stats->free += b->size;
+         if( b->size > stats->largest ) stats->largest = b->size;
+     }
+     unlock( mask );
+     stats->frag = stats->free ? 100 - stats->largest * 100 / stats->free : 0;
+}
+
+/*
+ *	MSYS_Dump() prints the heap figures and the call sites that have blocks
+ *	live, one line at a time through the given function. A site that keeps
+ *	growing between dumps is a leak.
+ *
+ *	@param	out			Prints one line of text
+ */
+void MSYS_Dump( void (*out)( const char *line ) )
+{
+     MSYS_STATS_Type s;
+     char line[80];
+     unsigned i;
+
+     MSYS_Stats( &s );
+     snprintf( line, sizeof(line), "heap %u used %u peak %u free %u largest %u frag %u%%\n\r",
+               s.size, s.used, s.peak, s.free, s.largest, s.frag );
+     out( line );
+     snprintf( line, sizeof(line), "allocs %u frees %u failed %u bad frees %u blocks %u\n\r",
+               s.allocs, s.frees, s.fails, s.bad_frees, s.blocks );
+     out( line );
+
+     for( i = 0; i <= MSYS_SITES; i++ )
+     {
+         if( msys.sites[i].live == 0 ) continue;
+         snprintf( line, sizeof(line), "  %s:%d live %u bytes %u\n\r",
+                   msys.sites[i].file, msys.sites[i].line, msys.sites[i].live, msys.sites[i].bytes );
+         out( line );
+     }
 }
+#endif
@@ -13,4 +13,35 @@ extern void MSYS_Free( void *ptr );
 extern void *MSYS_Alloc( unsigned size );
 extern void MSYS_Init( void *heap, unsigned len );
 extern void MSYS_Compact( void );
+
+#ifdef MSYS_STATS
+#define MSYS_SITES 16
+
+typedef struct {
+  unsigned size;                            /* bytes managed by the heap */
+  unsigned used;                            /* bytes in allocated blocks, including headers */
+  unsigned peak;                            /* the most bytes ever used at once */
+  unsigned free;                            /* bytes in free blocks */
+  unsigned largest;                         /* the largest free block */
+  unsigned frag;                            /* percent of free space outside the largest block */
+  unsigned blocks;                          /* blocks in the heap, used and free */
+  unsigned allocs;                          /* calls to MSYS_Alloc() */
+  unsigned frees;                           /* blocks freed */
+  unsigned fails;                           /* allocations that returned 0 */
+  unsigned bad_frees;                       /* frees of pointers that were not live blocks */
+} MSYS_STATS_Type;
+
+typedef struct {
+  const char *file;                         /* where MSYS_Alloc() was called from */
+  int line;
+  unsigned live;                            /* blocks from here not yet freed */
+  unsigned bytes;                           /* bytes in those blocks */
+} MSYS_SITE_Type;
+
+extern void *MSYS_AllocAt( unsigned size, const char *file, int line );
+extern void MSYS_Stats( MSYS_STATS_Type *stats );
+extern void MSYS_Dump( void (*out)( const char *line ) );
+
+#define MSYS_Alloc( size ) MSYS_AllocAt( (size), __FILE__, __LINE__ )
+#endif
 #endif
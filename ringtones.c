@@ -0,0 +1,67 @@
+/*
+ *	@author		abradbury
+ *
+ *	Ringtones.c is the library of ringtones that can be chosen from the
+ *	menu, sent and played. The table is const, so it and the RTTTL text are
+ *	kept in flash, one copy of each, and the menu lists the ringtones from
+ *	it (see menu.c), so adding a ringtone is just adding a line here and
+ *	changing RINGTONES.
+ *
+ *	This file has no hardware dependency, so the host benchmarks use the
+ *	same ringtones (bench/rtttl_bench.c and bench/tone_bench.c).
+ */
+
+#include "ctype.h"
+#include "string.h"
+#include "ringtones.h"
+
+const RINGTONE_Type	ringtones[] = {
+	{"Abdelazer",		"Abdelazer:d=4,o=5,b=160:2d,2f,2a,d6,8e6,8f6,8g6,8f6,8e6,8d6,2c#6,a6,8d6,8f6,8a6,8f6,d6,2a6,g6,8c6,8e6,8g6,8e6,c6,2a6,f6,8b,8d6,8f6,8d6,b,2g6,e6,8a,8c#6,8e6,8c6,a,2f6,8e6,8f6,8e6,8d6,c#6,f6,8e6,8f6,8e6,8d6,a,d6,8c#6,8d6,8e6,8d6,2d6"},
+	{"James Bond",		"jamesbond:d=8,o=5,b=160:e,g,p,d#6,d6,4p,g,a#,b,2p.,g,16a,16g,f#,4p,b4,e,c#,1p"},
+	{"Nokia Tune",		"nokiatune:d=4,o=5,b=112:8e6,8d6,f#,g#,8c#6,8b,d,e,8b,8a,c#,e,2a"},
+	{"Tubular Bells",	"Tubular Bells:d=4,o=5,b=280:c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6,c6,g6,c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6,c6,g6,c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6,c6,g6,c6,f6,c6,g6,c6,d#6,f6,c6,g#6,c6,a#6,c6,g6,g#6"},
+	{"Indiana Jones",	"IndianaJ:d=4,o=5,b=125:4e,16f,8g,2c6,4d,16e,1f,4g,16a,8b,2f6,4a,16b,4c6,4d6,4e6,4e,16f,8g,1c6,4d6,16e6,2f6,4g,16g,4e6,4d6,16g,4e6,4d6,16g,4f6,4e6,16d6,2c6"},
+	{"Thunderbirds",	"Thunderb:d=4,o=5,b=125:8g#,16f,16g#,4a#,8p,16d#,16f,8g#,8a#,8d#6,16f6,16c6,8d#6,8f6,2a#,8g#,16f,16g#,4a#,8p,16d#,16f,8g#,8a#,8d#6,16f6,16c6,8d#6,8f6,2g6,8g6,16a6,16e6,4g6,8p,16e6,16d6,8c6,8b,8a,16b,8c6,8e6,2d6"},
+	{"Inspect Gadget",	"Insepect:d=4,o=5,b=200:8g,8a,8p,8f,8p,8g#,8p,8e,8p,8g,8p,8f,8p,8d,8e,8f,8g,8a,8p,4d6,2c#6,2p,8d,8e,8f,8g,8a,8p,8f,8p,8g#,8p,8e,8p,8g,8p,8f,8p,4d,2p,4c#,4d"},
+	{"Superman",		"SuperMan:d=4,o=5,b=180:8g,8g,8g,c6,8c6,2g6,8p,8g6,8a.6,16g6,8f6,1g6,8p,8g,8g,8g,c6,8c6,2g6,8p,8g6,8a.6,16g6,8f6,8a6,2g.6,p,8c6,8c6,8c6,2b.6,g.6,8c6,8c6,8c6,2b.6,g.6,8c6,8c6,8c6,8b6,8a6,8b6,2c7,8c6,8c6,8c6,8c6,8c6,2c.6"},
+	{"Star Trek",		"Star Trek:d=4,o=5,b=063:8f.,16a#,d#.6,8d6,16a#.,16g.,16c.6,f6"},
+	{"Star Wars",		"StWars:d=4,o=5,b=180:8f,8f,8f,2a#.,2f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8d#6,2c6,p,8f,8f,8f,2a#.,2f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8c6,2a#.6,f.6,8d#6,8d6,8d#6,2c6"},
+};
+typedef char		ringtonesCheck[sizeof(ringtones)/sizeof(ringtones[0]) == RINGTONES ? 1 : -1];	// Fails to compile if RINGTONES is wrong
+
+/*
+ *	same() compares a name with the start of a string, ignoring case.
+ *
+ *	@param	name		The name, ended by '\0'
+ *	@param	str			The string, which must end where the name does or
+ *						at the character given
+ *	@param	end			The character that may end str, as well as '\0'
+ *	@return				1 if they are the same, 0 otherwise
+ */
+static int same(const char *name, const char *str, char end)
+{
+	while(*name && tolower((int)*name) == tolower((int)*str))
+	{
+		name++;
+		str++;
+	}
+	return *name == '\0' && (*str == '\0' || *str == end);
+}
+
+/*
+ *	ringtoneFind() looks for a ringtone by its title or by the name in its
+ *	RTTTL text, ignoring case, so "Star Wars" and "stwars" both find the
+ *	last one.
+ *
+ *	@param	name		The name to look for
+ *	@return				The index of the ringtone, -1 if there is none
+ */
+int ringtoneFind(const char *name)
+{
+	int i;
+	for(i=0; i<RINGTONES; i++)
+	{
+		if(same(name, ringtones[i].title, '\0') || same(name, ringtones[i].rtttl, ':')) return i;
+	}
+	return -1;
+}
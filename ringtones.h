@@ -0,0 +1,18 @@
+/*
+ *	@author		abradbury
+ */
+
+#ifndef __RINGTONES_H
+#define __RINGTONES_H
+
+#define RINGTONES		10		// The number of ringtones in the library
+
+typedef struct {
+	const char	*title;			// The name shown on the LCD, at most 16 characters
+	const char	*rtttl;			// The RTTTL text, sent and played
+} RINGTONE_Type;
+
+extern const RINGTONE_Type	ringtones[];
+
+int ringtoneFind(const char *name);
+#endif
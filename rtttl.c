@@ -0,0 +1,244 @@
+/*
+ *	@author		abradbury
+ *
+ *	Rtttl.c parses RTTTL ringtones, eg "nokiatune:d=4,o=5,b=112:8e6,8d6,f#",
+ *	in a single pass. It is a state machine that is fed the text a piece at
+ *	a time and gives each note to a callback as soon as its closing ',' is
+ *	read, so nothing is copied and the memory used is the RTTTL_PARSER
+ *	whatever the length of the ringtone. It has no hardware dependency, so
+ *	is also built into the host benchmark (bench/rtttl_bench.c).
+ *
+ *	The parser reads:
+ *	 - the name, up to the first ':'. Up to RTTTL_NAME-1 characters are
+ *	   kept, without the white space at either end.
+ *	 - the defaults, up to the second ':', as key=value pairs separated by
+ *	   commas in any order. Only the first letter of a key counts, so
+ *	   b=125 and bpm=125 are the same. d=4, o=5 and b=63 are used for any
+ *	   not given.
+ *	 - the notes, separated by commas. Each is an optional duration, the
+ *	   note letter (p for a pause), an optional '#', and an optional octave,
+ *	   with a '.' for a dotted note before or after the octave.
+ *
+ *	Values are as the specification allows: durations of 1, 2, 4, 8, 16 or
+ *	32, octaves RTTTL_OCT_MIN to RTTTL_OCT_MAX and RTTTL_BPM_MIN to
+ *	RTTTL_BPM_MAX beats per minute. A default outside these is ignored, and
+ *	a note's duration or octave outside them is replaced by the default.
+ *
+ *	White space (spaces, tabs and line ends) is ignored anywhere outside
+ *	the name, even inside a number, and letters may be either case. Numbers
+ *	are limited to 4 digits, so a long run of digits can not overflow.
+ */
+
+#include "rtttl.h"
+
+/*
+ *	isDigit(), isLetter() and isSpace() check a character, see digit() in
+ *	music.c.
+ */
+static int isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static int isLetter(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static int isSpace(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/*
+ *	lower() gives the lower case of a letter.
+ */
+static char lower(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? c + 'a' - 'A' : c;
+}
+
+/*
+ *	pitchOf() gives the note stream pitch of a note letter.
+ *
+ *	@param	c			The note letter, in lower case
+ *	@return				1-12 for C to B, 0 for a pause or anything unknown
+ */
+static int pitchOf(char c)
+{
+	switch(c)
+	{
+		case 'c': return 1;
+		case 'd': return 3;
+		case 'e': return 5;
+		case 'f': return 6;
+		case 'g': return 8;
+		case 'a': return 10;
+		case 'b': case 'h': return 12;
+		default: return 0;
+	}
+}
+
+/*
+ *	validDur(), validOct() and validBpm() check a value against the
+ *	specification.
+ */
+static int validDur(int dur)
+{
+	return dur >= 1 && dur <= RTTTL_DUR_MAX && (dur & (dur-1)) == 0;
+}
+
+static int validOct(int oct)
+{
+	return oct >= RTTTL_OCT_MIN && oct <= RTTTL_OCT_MAX;
+}
+
+static int validBpm(int bpm)
+{
+	return bpm >= RTTTL_BPM_MIN && bpm <= RTTTL_BPM_MAX;
+}
+
+/*
+ *	digitInto() adds a digit to a number being read.
+ */
+static int digitInto(int val, char c)
+{
+	if(val < 0) val = 0;
+	return val < 1000 ? val*10 + c - '0' : val;
+}
+
+/*
+ *	startNote() clears the note being read.
+ */
+static void startNote(RTTTL_PARSER *p)
+{
+	p->pitch = -1;
+	p->noteDur = 0;
+	p->noteOct = -1;
+	p->dot = 0;
+}
+
+/*
+ *	endNote() gives the note just read to the callback, with the defaults
+ *	filled in for a duration or octave not given or not allowed. Nothing is
+ *	given if no note letter was read, eg for a trailing comma.
+ */
+static void endNote(RTTTL_PARSER *p)
+{
+	if(p->pitch >= 0)
+	{
+		p->note(p, p->pitch, validOct(p->noteOct) ? p->noteOct : p->oct,
+				validDur(p->noteDur) ? p->noteDur : p->dur, p->dot);
+		p->count++;
+	}
+	startNote(p);
+}
+
+/*
+ *	endDefault() stores the default just read, if it is allowed. Unknown
+ *	keys are ignored.
+ */
+static void endDefault(RTTTL_PARSER *p)
+{
+	if(p->key == 'd' && validDur(p->val))		p->dur = p->val;
+	else if(p->key == 'o' && validOct(p->val))	p->oct = p->val;
+	else if(p->key == 'b' && validBpm(p->val))	p->bpm = p->val;
+	p->key = 0;
+	p->val = -1;
+}
+
+/*
+ *	rtttlInit() gets a parser ready for a new ringtone.
+ *
+ *	@param	p			The parser
+ *	@param	note		The function to give each note to
+ *	@param	ctx			Kept in p->ctx for the callback
+ */
+void rtttlInit(RTTTL_PARSER *p, RTTTL_NOTE note, void *ctx)
+{
+	p->state = RTTTL_IN_NAME;
+	p->name[0] = '\0';
+	p->len = 0;
+	p->dur = 4;
+	p->oct = 5;
+	p->bpm = 63;
+	p->key = 0;
+	p->val = -1;
+	p->count = 0;
+	p->note = note;
+	p->ctx = ctx;
+	startNote(p);
+}
+
+/*
+ *	rtttlFeed() parses the next piece of a ringtone. The pieces can be split
+ *	anywhere, even in the middle of a note.
+ *
+ *	@param	p			The parser
+ *	@param	str			The text
+ *	@param	len			The number of characters in str
+ */
+void rtttlFeed(RTTTL_PARSER *p, const char *str, int len)
+{
+	char c;
+
+	while(len-- > 0)
+	{
+		c = *str++;
+		switch(p->state)
+		{
+			case RTTTL_IN_NAME:
+				if(c == ':')
+				{
+					while(p->len > 0 && isSpace(p->name[p->len-1])) p->name[--p->len] = '\0';
+					p->state = RTTTL_IN_DEFAULTS;
+				}
+				else if(p->len == 0 && isSpace(c)) break;	// White space before the name
+				else if(p->len < RTTTL_NAME-1)
+				{
+					p->name[p->len++] = c;
+					p->name[p->len] = '\0';
+				}
+				break;
+
+			case RTTTL_IN_DEFAULTS:
+				if(c == ',' || c == ':')
+				{
+					endDefault(p);
+					if(c == ':') p->state = RTTTL_IN_NOTES;
+				}
+				else if(isDigit(c))		p->val = digitInto(p->val, c);
+				else if(isLetter(c) && p->key == 0)	p->key = lower(c);
+				break;
+
+			case RTTTL_IN_NOTES:
+				if(c == ',')			endNote(p);
+				else if(c == '.')		p->dot = 1;
+				else if(c == '#')
+				{
+					if(p->pitch > 0 && p->pitch < 12) p->pitch++;
+				}
+				else if(isDigit(c))
+				{
+					if(p->pitch < 0)	p->noteDur = digitInto(p->noteDur, c);
+					else				p->noteOct = digitInto(p->noteOct, c);
+				}
+				else if(isLetter(c) && p->pitch < 0) p->pitch = pitchOf(lower(c));
+				break;
+		}
+	}
+}
+
+/*
+ *	rtttlEnd() finishes a ringtone, giving the last note to the callback.
+ *
+ *	@param	p			The parser
+ *	@return				The number of notes, or -1 if the text did not
+ *						reach the notes (it had fewer than two ':')
+ */
+int rtttlEnd(RTTTL_PARSER *p)
+{
+	if(p->state != RTTTL_IN_NOTES) return -1;
+	endNote(p);
+	return p->count;
+}
@@ -0,0 +1,50 @@
+/*
+ *	@author		abradbury
+ */
+
+#ifndef __RTTTL_H
+#define __RTTTL_H
+
+#define RTTTL_NAME		32		// Size of a ringtone's name, with the '\0'
+#define RTTTL_DUR_MAX	32		// Shortest note, durations are 1, 2, 4, 8, 16 or 32
+#define RTTTL_OCT_MIN	4		// Octaves the specification allows
+#define RTTTL_OCT_MAX	7
+#define RTTTL_BPM_MIN	25		// Beats per minute the specification allows
+#define RTTTL_BPM_MAX	900
+
+#define RTTTL_IN_NAME		0	// Reading the name, up to the first ':'
+#define RTTTL_IN_DEFAULTS	1	// Reading the defaults, up to the second ':'
+#define RTTTL_IN_NOTES		2	// Reading the notes
+
+struct RTTTL_PARSER;
+
+/*
+ *	The note callback is given each note as it is parsed, with the default
+ *	duration and octave filled in. The pitch is 0 for a pause or 1-12 for C
+ *	to B, as in the note stream (see rtttlEncode()), and the duration is the
+ *	fraction of a whole note, eg 8 for a quaver.
+ */
+typedef void (*RTTTL_NOTE)(struct RTTTL_PARSER *p, int pitch, int octave, int dur, int dot);
+
+typedef struct RTTTL_PARSER {
+	int			state;			// One of the RTTTL_IN_ values
+	char		name[RTTTL_NAME];
+	int			len;			// Characters in name[]
+	int			dur;			// Default duration
+	int			oct;			// Default octave
+	int			bpm;			// Beats per minute
+	char		key;			// The default being read, 'd', 'o' or 'b', 0 before its first letter
+	int			val;			// The number being read, -1 if none
+	int			pitch;			// The note being read, -1 until its letter is read
+	int			noteDur;		// Its duration, 0 for the default
+	int			noteOct;		// Its octave, -1 for the default
+	int			dot;			// 1 if it is dotted
+	int			count;			// Notes given to the callback
+	RTTTL_NOTE	note;			// The note callback
+	void		*ctx;			// For the callback's use
+} RTTTL_PARSER;
+
+void rtttlInit(RTTTL_PARSER *p, RTTTL_NOTE note, void *ctx);
+void rtttlFeed(RTTTL_PARSER *p, const char *str, int len);
+int rtttlEnd(RTTTL_PARSER *p);
+#endif
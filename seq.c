@@ -0,0 +1,234 @@
+/*
+ *	@author		abradbury
+ *
+ *	Seq.c plays sequences of note events (see tone.h) in the background,
+ *	one on each voice of the synthesiser (see synth.c), so a chord or a
+ *	notification can be played over a ringtone. Timer0 counts milliseconds
+ *	and is left running while any sequence plays; each voice has its own
+ *	match register (MR0 to MR3), which is moved on by the length of each
+ *	note, and the match interrupt starts the voice's next note by giving it
+ *	to the synthesiser. The CPU is only used for a few instructions at each
+ *	note boundary, so the menu, the LCD and CAN messages carry on while a
+ *	ringtone plays.
+ *
+ *	Moving the match register on, rather than resetting the timer, means
+ *	the time taken to handle the interrupt is not added to each note, and
+ *	the voices keep time with each other.
+ *
+ *	The events are read while they play, so must not be freed or changed
+ *	until seqStatus() gives SEQ_IDLE or seqStop() has been called. A note
+ *	of the same pitch as the one before is released for SEQ_GAP ms and
+ *	attacked again (see synth.c), so the two can be told apart. When the
+ *	last voice stops, the timer and the DAC are left running for SEQ_TAIL
+ *	ms so its release dies away rather than being cut off.
+ */
+
+#include "lpc17xx_timer.h"
+#include "dac.h"
+#include "synth.h"
+#include "seq.h"
+
+// The match register of each voice, MR0 to MR3 are next to each other
+#define SEQ_MATCH(voice)	((&LPC_TIM0->MR0)[voice])
+
+typedef struct {
+	const NOTE_EVENT	*events;	// The sequence playing
+	int					count;		// The number of events in it
+	volatile int		pos;		// The next event to start
+	volatile int		state;		// SEQ_IDLE or SEQ_PLAYING
+	uint16_t			prev;		// The note playing, 0 for a pause
+	int					gap;		// 1 while the gap before a repeated note is played
+} SEQ_VOICE;
+
+SEQ_VOICE			seqVoices[SEQ_VOICES];	// The sequence on each voice
+volatile int		seqPlaying = 0;			// The number of voices playing
+int					seqTail = 0;			// 1 + the voice timing the release after the last note
+
+TIM_TIMERCFG_Type	Timer0;		// The timer struct used for note timing
+TIM_MATCHCFG_Type	Match0;		// The match struct used for note timing
+
+/*
+ *	init_seq() sets up Timer0 to count milliseconds and interrupt on a
+ *	match with the register of any voice, without starting it.
+ */
+void init_seq(void)
+{
+	int v;
+
+	Timer0.PrescaleOption = TIM_PRESCALE_USVAL;	// Prescale in microsecond value
+	Timer0.PrescaleValue = 1000;				// 1000 us = 1 ms
+	TIM_Init(LPC_TIM0, TIM_TIMER_MODE, &Timer0);
+
+	for(v=0; v<SEQ_VOICES; v++)
+	{
+		Match0.MatchChannel = v;			// One match channel per voice
+		Match0.IntOnMatch = ENABLE;			// Interrupt on match
+		Match0.StopOnMatch = DISABLE;		// Keep counting, the next note is timed from here
+		Match0.ResetOnMatch = DISABLE;		// Do not reset on match
+		Match0.ExtMatchOutputType = TIM_EXTMATCH_NOTHING;// Do nothing to external output pin when match
+		Match0.MatchValue = 0;
+		TIM_ConfigMatch(LPC_TIM0, &Match0);
+	}
+	NVIC_EnableIRQ(TIMER0_IRQn);
+}
+
+/*
+ *	seqHalt() stops a voice, releasing its note. Once no voice is left
+ *	playing, the voice's match register is set to stop the timer and the
+ *	DAC when the release is over. It is called with the timer interrupt
+ *	off, or from it.
+ *
+ *	@param	voice		The voice
+ */
+static void seqHalt(int voice)
+{
+	synthNote(voice, 0);
+	TIM_ClearIntPending(LPC_TIM0, (TIM_INT_TYPE)(TIM_MR0_INT+voice));
+	if(seqVoices[voice].state != SEQ_PLAYING) return;
+
+	seqVoices[voice].state = SEQ_IDLE;
+	seqPlaying--;
+	if(seqPlaying == 0)
+	{
+		SEQ_MATCH(voice) = LPC_TIM0->TC + SEQ_TAIL;
+		seqTail = voice+1;
+	}
+}
+
+/*
+ *	seqNext() starts the next event on a voice and sets its match register
+ *	to the end of it. Events of no length are skipped, and the voice is
+ *	stopped after the last one. It is called by seqStart() and the timer
+ *	interrupt.
+ *
+ *	@param	voice		The voice
+ */
+static void seqNext(int voice)
+{
+	SEQ_VOICE *s = &seqVoices[voice];
+	const NOTE_EVENT *e;
+	uint32_t len;
+
+	while(s->pos < s->count && s->events[s->pos].ticks == 0) s->pos++;
+	if(s->pos >= s->count)
+	{
+		seqHalt(voice);
+		return;
+	}
+
+	e = &s->events[s->pos];
+	len = e->ticks;
+	if(!s->gap && e->note != 0 && e->note == s->prev && len > SEQ_GAP)
+	{
+		synthNote(voice, 0);			// Release, then start this event again
+		s->gap = 1;
+		SEQ_MATCH(voice) += SEQ_GAP;
+		return;
+	}
+	if(s->gap) len -= SEQ_GAP;
+	s->gap = 0;
+
+	synthNote(voice, e->note);
+	s->prev = e->note;
+	s->pos++;
+	SEQ_MATCH(voice) += len;
+}
+
+/*
+ *	TIMER0_IRQHandler() is called at the end of a note on any voice, and
+ *	starts the next one on each voice whose note has ended.
+ */
+void TIMER0_IRQHandler()
+{
+	int v;
+
+	for(v=0; v<SEQ_VOICES; v++)
+	{
+		if(TIM_GetIntStatus(LPC_TIM0, (TIM_INT_TYPE)(TIM_MR0_INT+v)))
+		{
+			TIM_ClearIntPending(LPC_TIM0, (TIM_INT_TYPE)(TIM_MR0_INT+v));
+			if(seqVoices[v].state == SEQ_PLAYING)
+			{
+				seqNext(v);
+			}
+			else if(seqTail == v+1 && seqPlaying == 0)
+			{
+				seqTail = 0;				// The last release is over
+				TIM_Cmd(LPC_TIM0, DISABLE);
+				dacStop();
+			}
+		}
+	}
+}
+
+/*
+ *	seqStart() starts playing a sequence of notes on a voice, stopping any
+ *	that is playing on it. The other voices carry on. It returns straight
+ *	away.
+ *
+ *	@param	voice		The voice, 0 to SEQ_VOICES-1
+ *	@param	events		The notes, which must be kept until they have played
+ *	@param	count		The number of notes
+ */
+void seqStart(int voice, const NOTE_EVENT *events, int count)
+{
+	SEQ_VOICE *s;
+	int first;
+
+	if(voice < 0 || voice >= SEQ_VOICES) return;
+	s = &seqVoices[voice];
+
+	NVIC_DisableIRQ(TIMER0_IRQn);		// The other voices must not stop the DAC meanwhile
+	seqHalt(voice);
+	first = (seqPlaying == 0);
+	seqTail = 0;						// The DAC is kept running for this voice instead
+	if(first) TIM_ResetCounter(LPC_TIM0);
+
+	s->events = events;
+	s->count = count;
+	s->pos = 0;
+	s->prev = 0;
+	s->gap = 0;
+	s->state = SEQ_PLAYING;
+	seqPlaying++;
+
+	SEQ_MATCH(voice) = LPC_TIM0->TC;
+	seqNext(voice);
+	TIM_ClearIntPending(LPC_TIM0, (TIM_INT_TYPE)(TIM_MR0_INT+voice));	// In case it matched before being moved on
+	if(first && s->state == SEQ_PLAYING)
+	{
+		dacStart();
+		TIM_Cmd(LPC_TIM0, ENABLE);
+	}
+	NVIC_EnableIRQ(TIMER0_IRQn);
+}
+
+/*
+ *	seqStop() stops the sequence playing on a voice, if there is one. When
+ *	no voice is left playing, the timer and the DAC are stopped once the
+ *	last note has been released.
+ *
+ *	@param	voice		The voice, 0 to SEQ_VOICES-1
+ */
+void seqStop(int voice)
+{
+	if(voice < 0 || voice >= SEQ_VOICES) return;
+
+	NVIC_DisableIRQ(TIMER0_IRQn);
+	seqHalt(voice);
+	NVIC_EnableIRQ(TIMER0_IRQn);
+}
+
+/*
+ *	seqStatus() says whether a sequence is playing on a voice.
+ *
+ *	@param	voice		The voice, 0 to SEQ_VOICES-1
+ *	@param	played		If not 0, set to the number of events started
+ *	@return				SEQ_PLAYING or SEQ_IDLE
+ */
+int seqStatus(int voice, int *played)
+{
+	if(voice < 0 || voice >= SEQ_VOICES) return SEQ_IDLE;
+	if(played) *played = seqVoices[voice].pos;
+	return seqVoices[voice].state;
+}
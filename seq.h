@@ -0,0 +1,22 @@
+/*
+ *	@author		abradbury
+ */
+
+#ifndef __SEQ_H
+#define __SEQ_H
+
+#include "tone.h"
+#include "synth.h"
+
+#define SEQ_IDLE		0		// Nothing is playing
+#define SEQ_PLAYING		1		// A sequence of notes is playing
+#define SEQ_VOICES		SYNTH_VOICES	// Sequences played at once, one per voice
+
+#define SEQ_GAP			10		// Release in ms before a note of the same pitch as the last
+#define SEQ_TAIL		SYNTH_FALL_MS	// Time in ms for the last note to die away
+
+void init_seq(void);
+void seqStart(int voice, const NOTE_EVENT *events, int count);
+void seqStop(int voice);
+int seqStatus(int voice, int *played);
+#endif
@@ -6,6 +6,7 @@
  
 #include "lpc17xx_uart.h"
 #include "lpc17xx_pinsel.h"
+#include "lpc17xx_timer.h"
 #include "lpc_types.h"
 #include "serial.h"
 #include "stdio.h"
@@ -21,21 +22,34 @@
 #include "music.h"
 #include "menu.h"
 #include "morse.h"
+#include "stack.h"
+#include "seq.h"
 
 /*	
  *	main() is the main entry point into the program, it is from 
- *	here that all other methods are called.
+ *	here that all other methods are called. After setting up, it reads 
+ *	keys for ever, passing each one to menuHandler().
  */
 void main(void)
 {
+	unsigned char key;
+	
+#ifdef STACK_WATERMARK
+	stackPaint();
+#endif
 	serial_init();
 	
 	write_usb_serial_blocking("\n\r**************\n\r",20);
 	write_usb_serial_blocking("Program started \n\r",20);
 	
+	init_ticks();
 	init_i2c();
 	init_lcd();
 	init_DAC();
+	init_seq();
+#ifdef MEMMAP_BENCH
+	memmapBench();
+#endif
 	seg_clear();
 	init_CAN();
 	init_morse(25);
@@ -43,9 +57,16 @@ void main(void)
 	menuScreen(99,0);
 	
 	write_usb_serial_blocking("\n\r",2);
-	menuHandler(readkey());
-
-	write_usb_serial_blocking("Finished main\n\r",16);
+	while(1)
+	{
+		key = key_to_charcode(readkey());
+		STACK_BEGIN(STACK_MENU);
+		menuHandler(key);
+		STACK_END(STACK_MENU);
+#ifdef STACK_WATERMARK
+		stackReport();
+#endif
+	}
 }
 
 /*	
@@ -62,6 +83,32 @@ void delay (unsigned int tick)
 	}
 }
 
+/*	
+ *	init_ticks() starts Timer2 as a free running millisecond counter, used 
+ *	for timeouts that need to be measured while other work is done.
+ */
+void init_ticks(void)
+{
+	TIM_TIMERCFG_Type	Timer2;
+	
+	Timer2.PrescaleOption = TIM_PRESCALE_USVAL;	// Prescale in microsecond value
+	Timer2.PrescaleValue = 1000;				// 1000 us = 1 ms
+	
+	TIM_Init(LPC_TIM2, TIM_TIMER_MODE, &Timer2);
+	TIM_Cmd(LPC_TIM2, ENABLE);
+}
+
+/*	
+ *	ticks() returns the number of milliseconds since init_ticks() was called. 
+ *	It wraps after about 49 days, so compare values by subtraction.
+ *	
+ *	@return				The millisecond count
+ */
+unsigned int ticks(void)
+{
+	return LPC_TIM2->TC;
+}
+
 /*	
  *	read_usb_serial_blocking() reads text from the USB line. This can  
  *	be read via a terminal screen on a computer.
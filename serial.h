@@ -3,6 +3,9 @@
  */
  
 void delay (unsigned int tick);
+void init_ticks(void);
+void memmapBench(void);
+unsigned int ticks(void);
 int read_usb_serial_none_blocking(char *buf,int length);
 int write_usb_serial_blocking(char *buf,int length);
 void serial_init(void);
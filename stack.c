@@ -0,0 +1,159 @@
+/*
+ *	@author		abradbury
+ *
+ *	Stack.c measures how much stack each part of the program uses. It is
+ *	only built when STACK_WATERMARK is defined. At start up the bottom of
+ *	the stack (STACK_PAINT bytes below STACK_TOP, see memmap.h) is filled
+ *	with a pattern. The deepest word that no longer holds the pattern marks
+ *	the most stack that has been used, the high-water mark.
+ *
+ *	To split this up by subsystem, STACK_BEGIN() takes the high-water mark
+ *	so far, then paints again below the current stack pointer, and
+ *	STACK_END() takes the mark again. The figure kept for a subsystem is the
+ *	deepest the stack went while it was running, measured from the top of
+ *	the stack, so it includes anything it called and any interrupt taken
+ *	while it ran. Subsystems can be measured inside each other (the inbox
+ *	is decoded from the menu, the CAN interrupt can arrive at any time), up
+ *	to NEST deep; every subsystem running is given the depth found.
+ *
+ *	Interrupts are off while the stack is painted, as an interrupt would
+ *	push its registers onto the part being painted. Painting 4 KB takes
+ *	around 10 us, which is why this is not built in normally.
+ */
+
+#ifdef STACK_WATERMARK
+
+#include "LPC17xx.h"
+#include "debug_frmwrk.h"
+#include "serial.h"
+#include "string.h"
+#include "memmap.h"
+#include "stack.h"
+
+#define PATTERN		0xC5C5C5C5	// Written to unused stack
+#define NEST		4			// Most subsystems measured inside each other
+
+uint32_t * const	stackBottom = (uint32_t *) (STACK_TOP - STACK_PAINT);	// Lowest word painted
+uint32_t			stackPeak[STACK_SUBS];		// The deepest each subsystem has used, in bytes
+uint32_t			stackShown[STACK_SUBS];		// The peaks last printed by stackReport()
+int					stackActive[NEST];			// The subsystems running, outermost first
+int					stackNest = 0;				// The number of subsystems running
+char				*stackName[STACK_SUBS] = {"menu", "CAN", "inbox", "music", "morse"};
+
+/*
+ *	paint() fills the stack from stackBottom up to the stack pointer with 
+ *	the pattern. Interrupts must be off, so nothing below it is in use.
+ */
+static void paint(void)
+{
+	uint32_t *p = stackBottom;
+	uint32_t *sp = (uint32_t *) __get_MSP();
+
+	while(p < sp) *p++ = PATTERN;
+}
+
+/*
+ *	depth() finds the high-water mark since the stack was last painted.
+ *
+ *	@return				The bytes used, measured from the top of the stack
+ */
+static uint32_t depth(void)
+{
+	uint32_t *p = stackBottom;
+
+	while(p < (uint32_t *) STACK_TOP && *p == PATTERN) p++;
+	return STACK_TOP - (uint32_t) p;
+}
+
+/*
+ *	credit() gives a depth to every subsystem that is running.
+ *
+ *	@param	used		The depth in bytes
+ */
+static void credit(uint32_t used)
+{
+	int i;
+
+	for(i = 0; i < stackNest && i < NEST; i++)
+	{
+		if(used > stackPeak[stackActive[i]]) stackPeak[stackActive[i]] = used;
+	}
+}
+
+/*
+ *	stackPaint() paints the whole of the measured stack. It is called
+ *	first thing in main().
+ */
+void stackPaint(void)
+{
+	uint32_t mask = __get_PRIMASK();
+
+	__disable_irq();
+	paint();
+	stackNest = 0;
+	__set_PRIMASK(mask);
+}
+
+/*
+ *	stackBegin() is called (through STACK_BEGIN()) as a subsystem starts.
+ *
+ *	@param	sub			The subsystem, one of the STACK_ values in stack.h
+ */
+void stackBegin(int sub)
+{
+	uint32_t mask = __get_PRIMASK();
+
+	__disable_irq();
+	credit(depth());
+	if(stackNest < NEST) stackActive[stackNest] = sub;
+	stackNest++;
+	paint();
+	__set_PRIMASK(mask);
+}
+
+/*
+ *	stackEnd() is called (through STACK_END()) as a subsystem finishes.
+ *
+ *	@param	sub			The subsystem, as given to stackBegin()
+ */
+void stackEnd(int sub)
+{
+	uint32_t mask = __get_PRIMASK();
+
+	__disable_irq();
+	credit(depth());
+	if(stackNest > 0) stackNest--;
+	__set_PRIMASK(mask);
+}
+
+/*
+ *	stackReport() prints the peak stack use of every subsystem to the
+ *	terminal, if any of them has gone up since it last printed. A peak of
+ *	STACK_PAINT bytes means the stack went past the painted area, so
+ *	STACK_PAINT should be raised to find the real figure.
+ */
+void stackReport(void)
+{
+	int i, changed = 0;
+
+	for(i = 0; i < STACK_SUBS; i++)
+	{
+		if(stackPeak[i] != stackShown[i]) changed = 1;
+	}
+	if(!changed) return;
+
+	write_usb_serial_blocking("\n\rStack peak (bytes of ",23);
+	UARTPutDec16((LPC_UART_TypeDef *)LPC_UART0, STACK_PAINT);
+	write_usb_serial_blocking("):",2);
+	for(i = 0; i < STACK_SUBS; i++)
+	{
+		stackShown[i] = stackPeak[i];
+		write_usb_serial_blocking(" ",1);
+		write_usb_serial_blocking(stackName[i],strlen(stackName[i]));
+		write_usb_serial_blocking(" ",1);
+		UARTPutDec16((LPC_UART_TypeDef *)LPC_UART0, stackShown[i]);
+	}
+	write_usb_serial_blocking("\n\r",2);
+}
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ *	@author		abradbury
+ */
+
+#ifndef __STACK_H
+#define __STACK_H
+
+#define STACK_MENU		0		// The menu, from main()
+#define STACK_CAN		1		// The CAN receive interrupt
+#define STACK_INBOX		2		// Decoding buffered messages
+#define STACK_MUSIC		3		// Decoding and playing a ringtone
+#define STACK_MORSE		4		// Playing a message as morse code
+#define STACK_SUBS		5
+
+#ifdef STACK_WATERMARK
+void stackPaint(void);
+void stackBegin(int sub);
+void stackEnd(int sub);
+void stackReport(void);
+#define STACK_BEGIN(s)	stackBegin(s)
+#define STACK_END(s)	stackEnd(s)
+#else
+#define STACK_BEGIN(s)
+#define STACK_END(s)
+#endif
+#endif
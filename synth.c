@@ -0,0 +1,293 @@
+/*
+ *	@author		abradbury
+ *
+ *	Synth.c makes the samples sent to the DAC by direct digital synthesis.
+ *	The DAC is fed at a fixed rate, SYNTH_RATE, and a 32 bit phase
+ *	accumulator is stepped through a SYNTH_WAVE sample wavetable once per
+ *	sample; the top SYNTH_BITS bits of the phase pick the sample. The step
+ *	sets the frequency, step = frequency * 2^32 / SYNTH_RATE, so any can be
+ *	played to within SYNTH_RATE / 2^32 (about 5 micro Hz), and every sample
+ *	costs the same whatever the note.
+ *
+ *	The wavetables (sine, square, triangle and saw), the envelopes and the
+ *	steps for the 48 notes of octaves 4 to 7 are all worked out by the
+ *	compiler. The sine is Bhaskara's approximation,
+ *	sin(x) ~ 16x(pi-x) / (5pi^2 - 4x(pi-x)), which needs no floating point
+ *	and is within 0.2% of the peak.
+ *
+ *	Each voice has an attack, decay, sustain and release envelope, stepped
+ *	once every SYNTH_TICK samples from a table, so the only sum per sample
+ *	is the one that mixes it. A note on starts the attack from the level
+ *	the voice is at, so a note played straight after another does not
+ *	click, and a note off starts the release from there. Notes are handed
+ *	to the DMA interrupt as events and started at the next tick, so the
+ *	timer interrupt that sequences them never changes a voice mid-block.
+ *
+ *	There are SYNTH_VOICES oscillators, each with its own phase, step, gain,
+ *	wave and envelope, so a chord or a notification can be played over a
+ *	ringtone. They are mixed one voice at a time into a block of 32 bit sums,
+ *	so a silent voice costs nothing and the inner loop keeps its phase and
+ *	step in registers, then the sums are saturated to the DAC's range. On
+ *	the Cortex-M3 that is a single SSAT instruction per sample.
+ *
+ *	Samples are rendered a block at a time by synthRender(), called from the
+ *	DMA interrupt (see dac.c) for the half of the buffer the DMA has just
+ *	finished sending. This file has no hardware dependency, so is also built
+ *	into the host benchmark (bench/synth_bench.c).
+ */
+
+#include "synth.h"
+
+#define SYNTH_OFF		0		// Envelope stages: silent, the voice is skipped
+#define SYNTH_RISE		1		// The attack and the decay
+#define SYNTH_HOLD		2		// The sustain
+#define SYNTH_FALL		3		// The release
+
+#define SYNTH_ON		1		// Events: a note on
+#define SYNTH_RELEASE	2		// A note off
+
+// Bhaskara's sine of sample i of a half cycle of h samples, scaled to SYNTH_AMP
+#define BHASKARA(i, h)	(int16_t)((16l*(i)*((h)-(i))*SYNTH_AMP) / (5l*(h)*(h) - 4l*(i)*((h)-(i))))
+#define SINE(i)			((i) < SYNTH_WAVE/2 ? BHASKARA(i, SYNTH_WAVE/2) : -BHASKARA((i)-SYNTH_WAVE/2, SYNTH_WAVE/2))
+#define SQUARE(i)		((i) < SYNTH_WAVE/2 ? SYNTH_AMP : -SYNTH_AMP)
+#define TRIANGLE(i)		(int16_t)((i) < SYNTH_WAVE/4 ? SYNTH_AMP*(i)/(SYNTH_WAVE/4) : \
+						(i) < 3*SYNTH_WAVE/4 ? SYNTH_AMP*(SYNTH_WAVE/2-(i))/(SYNTH_WAVE/4) : \
+						SYNTH_AMP*((i)-SYNTH_WAVE)/(SYNTH_WAVE/4))
+#define SAW(i)			(int16_t)(SYNTH_AMP*((i) < SYNTH_WAVE/2 ? (i) : (i)-SYNTH_WAVE)/(SYNTH_WAVE/2))
+#define WAVE4(f, i)		f(i), f((i)+1), f((i)+2), f((i)+3)
+#define WAVE16(f, i)	WAVE4(f, i), WAVE4(f, (i)+4), WAVE4(f, (i)+8), WAVE4(f, (i)+12)
+#define WAVE64(f, i)	WAVE16(f, i), WAVE16(f, (i)+16), WAVE16(f, (i)+32), WAVE16(f, (i)+48)
+#define WAVE(f)			{WAVE64(f, 0), WAVE64(f, 64), WAVE64(f, 128), WAVE64(f, 192)}
+#if SYNTH_WAVE != 256
+#error "synthWaves[] are written out for 256 samples"
+#endif
+
+// The frequencies of C to B in the 4th octave, in hundredths of a Hz, doubled for each octave above
+#define OCTAVE(oct)		SYNTH_STEP(26163ull << (oct)), SYNTH_STEP(27718ull << (oct)), SYNTH_STEP(29366ull << (oct)), \
+						SYNTH_STEP(31113ull << (oct)), SYNTH_STEP(32963ull << (oct)), SYNTH_STEP(34923ull << (oct)), \
+						SYNTH_STEP(36999ull << (oct)), SYNTH_STEP(39200ull << (oct)), SYNTH_STEP(41530ull << (oct)), \
+						SYNTH_STEP(44000ull << (oct)), SYNTH_STEP(46616ull << (oct)), SYNTH_STEP(49388ull << (oct))
+
+// The piano envelope: a 3 tick attack, then a decay to the sustain over 20 ticks, then an 8 tick release, all quadratic
+#define PIANO_SUSTAIN	160
+#define DECAY(k)		(PIANO_SUSTAIN + (SYNTH_GAIN-PIANO_SUSTAIN)*(20-(k))*(20-(k))/400)
+#define DECAY5(k)		DECAY(k), DECAY((k)+1), DECAY((k)+2), DECAY((k)+3), DECAY((k)+4)
+#define FALL(k, n)		(SYNTH_GAIN*((n)-(k))*((n)-(k))/((n)*(n)))
+
+const int16_t	synthWaves[SYNTH_SHAPES][SYNTH_WAVE] = {WAVE(SINE), WAVE(SQUARE), WAVE(TRIANGLE), WAVE(SAW)};
+const uint32_t	synthSteps[SYNTH_NOTES+1] = {0, OCTAVE(0), OCTAVE(1), OCTAVE(2), OCTAVE(3)};
+
+static const uint16_t	pianoRise[] = {SYNTH_GAIN/3, 2*SYNTH_GAIN/3, SYNTH_GAIN, DECAY5(1), DECAY5(6), DECAY5(11), DECAY5(16)};
+static const uint16_t	pianoFall[] = {FALL(1, 8), FALL(2, 8), FALL(3, 8), FALL(4, 8), FALL(5, 8), FALL(6, 8), FALL(7, 8), FALL(8, 8)};
+static const uint16_t	organRise[] = {SYNTH_GAIN};
+static const uint16_t	organFall[] = {FALL(1, 2), FALL(2, 2)};
+
+const SYNTH_ENV	synthEnvs[SYNTH_ENVS] = {
+	{pianoRise, sizeof(pianoRise)/sizeof(pianoRise[0]), PIANO_SUSTAIN, pianoFall, sizeof(pianoFall)/sizeof(pianoFall[0])},
+	{organRise, sizeof(organRise)/sizeof(organRise[0]), SYNTH_GAIN, organFall, sizeof(organFall)/sizeof(organFall[0])},
+};
+
+#if SYNTH_VOICES != 4
+#error "synthVoices[] is written out for 4 voices"
+#endif
+#define VOICE			{0, 0, SYNTH_GAIN, synthWaves[SYNTH_SINE], &synthEnvs[SYNTH_PIANO], SYNTH_OFF, 0, 0, 0, 0, 0}
+SYNTH_VOICE		synthVoices[SYNTH_VOICES] = {VOICE, VOICE, VOICE, VOICE};
+int32_t			synthMix[SYNTH_TICK];	// The sum of the voices for a tick
+
+/*
+ *	synthSat() limits a sample to the DAC's range, -SYNTH_MID to SYNTH_AMP.
+ */
+static inline int32_t synthSat(int32_t x)
+{
+#ifdef __arm__
+	__asm__("ssat %0, #10, %1" : "=r" (x) : "r" (x));
+	return x;
+#else
+	if(x > SYNTH_AMP) return SYNTH_AMP;
+	if(x < -SYNTH_MID) return -SYNTH_MID;
+	return x;
+#endif
+}
+
+/*
+ *	synthNote() starts a note on a voice, or releases the one playing.
+ *
+ *	@param	voice		The voice, 0 to SYNTH_VOICES-1
+ *	@param	note		The note number, 1-48 for C4 to B7, 0 for silence
+ */
+void synthNote(int voice, int note)
+{
+	synthStep(voice, note > 0 && note <= SYNTH_NOTES ? synthSteps[note] : 0);
+}
+
+/*
+ *	synthStep() starts a sound on a voice, for sounds that are not notes, 
+ *	or releases the one playing. It takes effect at the next tick. The
+ *	phase carries on from the last note, so the wave has no jump in it.
+ *
+ *	The event is written after the step, and the DMA interrupt that reads
+ *	them has the same priority as the timer interrupt that calls this, so
+ *	never sees half a note.
+ *
+ *	@param	voice		The voice, 0 to SYNTH_VOICES-1
+ *	@param	step		The phase step, from SYNTH_STEP(), 0 to release
+ */
+void synthStep(int voice, uint32_t step)
+{
+	if(voice < 0 || voice >= SYNTH_VOICES) return;
+	synthVoices[voice].next = step;
+	synthVoices[voice].event = step ? SYNTH_ON : SYNTH_RELEASE;
+}
+
+/*
+ *	synthGain() sets the volume of a voice. The voices are added together,
+ *	so with more than one playing the gains should add up to about
+ *	SYNTH_GAIN; louder mixes are clipped rather than wrapped round.
+ *
+ *	@param	voice		The voice, 0 to SYNTH_VOICES-1
+ *	@param	gain		0 to SYNTH_GAIN
+ */
+void synthGain(int voice, int gain)
+{
+	if(gain < 0) gain = 0;
+	if(gain > SYNTH_GAIN) gain = SYNTH_GAIN;
+	if(voice >= 0 && voice < SYNTH_VOICES) synthVoices[voice].gain = gain;
+}
+
+/*
+ *	synthShape() sets the wave played by a voice, from the next sample.
+ *
+ *	@param	voice		The voice, 0 to SYNTH_VOICES-1
+ *	@param	shape		SYNTH_SINE, SYNTH_SQUARE, SYNTH_TRIANGLE or 
+ *						SYNTH_SAW
+ */
+void synthShape(int voice, int shape)
+{
+	if(voice >= 0 && voice < SYNTH_VOICES && shape >= 0 && shape < SYNTH_SHAPES)
+	{
+		synthVoices[voice].wave = synthWaves[shape];
+	}
+}
+
+/*
+ *	synthEnvelope() sets the envelope of a voice, from its next note.
+ *
+ *	@param	voice		The voice, 0 to SYNTH_VOICES-1
+ *	@param	env			SYNTH_PIANO or SYNTH_ORGAN
+ */
+void synthEnvelope(int voice, int env)
+{
+	if(voice >= 0 && voice < SYNTH_VOICES && env >= 0 && env < SYNTH_ENVS)
+	{
+		synthVoices[voice].env = &synthEnvs[env];
+	}
+}
+
+/*
+ *	synthTick() starts any note on or off handed to a voice and moves its
+ *	envelope on a tick.
+ *
+ *	@param	v			The voice
+ *	@return				The level of the voice for the tick
+ */
+static int32_t synthTick(SYNTH_VOICE *v)
+{
+	const SYNTH_ENV *env = v->env;
+	int event = v->event;
+
+	if(event == SYNTH_ON)
+	{
+		// Attack from the level the voice is at, rather than from silence
+		v->step = v->next;
+		v->event = 0;
+		v->pos = 0;
+		while(v->pos < env->riseLen-1 && env->rise[v->pos] < v->level) v->pos++;
+		v->stage = SYNTH_RISE;
+	}
+	else if(event == SYNTH_RELEASE)
+	{
+		v->event = 0;
+		if(v->stage != SYNTH_OFF)
+		{
+			v->held = v->level;
+			v->pos = 0;
+			v->stage = SYNTH_FALL;
+		}
+	}
+
+	switch(v->stage)
+	{
+		case SYNTH_RISE:
+			v->level = env->rise[v->pos++];
+			if(v->pos >= env->riseLen) v->stage = SYNTH_HOLD;
+			break;
+		case SYNTH_HOLD:
+			v->level = env->sustain;
+			break;
+		case SYNTH_FALL:
+			if(v->pos < env->fallLen)
+			{
+				v->level = (v->held * env->fall[v->pos++]) >> SYNTH_GAIN_BITS;
+				break;
+			}
+			v->stage = SYNTH_OFF;
+			// Fall through
+		default:
+			v->level = 0;
+			break;
+	}
+	return v->level;
+}
+
+/*
+ *	synthRender() renders a block of samples, the mix of the voices playing,
+ *	in the form written to the DAC register (the 10 bit value in bits 15-6).
+ *	The envelopes are moved on once every SYNTH_TICK samples, so blocks
+ *	should be a multiple of SYNTH_TICK long.
+ *
+ *	@param	out			The block to fill
+ *	@param	n			The number of samples
+ */
+void synthRender(uint32_t *out, int n)
+{
+	SYNTH_VOICE *v;
+	const int16_t *wave;
+	uint32_t phase, step;
+	int32_t gain;
+	int i, m, voices;
+
+	for(; n > 0; n -= m, out += m)
+	{
+		m = n < SYNTH_TICK ? n : SYNTH_TICK;
+		voices = 0;
+		for(v = synthVoices; v < &synthVoices[SYNTH_VOICES]; v++)
+		{
+			if(v->stage == SYNTH_OFF && v->event != SYNTH_ON) continue;
+			gain = (v->gain * synthTick(v)) >> SYNTH_GAIN_BITS;
+			if(gain == 0) continue;
+
+			phase = v->phase;
+			step = v->step;
+			wave = v->wave;
+			if(voices++ == 0)
+			{
+				// The first voice sets the sums, so they need not be cleared
+				for(i=0; i<m; i++, phase += step) synthMix[i] = wave[phase >> (32-SYNTH_BITS)] * gain;
+			}
+			else
+			{
+				for(i=0; i<m; i++, phase += step) synthMix[i] += wave[phase >> (32-SYNTH_BITS)] * gain;
+			}
+			v->phase = phase;
+		}
+
+		if(voices == 0)
+		{
+			for(i=0; i<m; i++) out[i] = SYNTH_MID << 6;
+		}
+		else
+		{
+			for(i=0; i<m; i++) out[i] = (uint32_t)(SYNTH_MID + synthSat(synthMix[i] >> SYNTH_GAIN_BITS)) << 6;
+		}
+	}
+}
@@ -0,0 +1,71 @@
+/*
+ *	@author		abradbury
+ */
+
+#ifndef __SYNTH_H
+#define __SYNTH_H
+
+#include "stdint.h"
+
+#define SYNTH_RATE		20000	// Output sample rate in Hz
+#define SYNTH_BITS		8		// Bits of the phase that pick the sample
+#define SYNTH_WAVE		(1 << SYNTH_BITS)	// Samples in each wavetable
+#define SYNTH_AMP		511		// Peak of the wavetables, the DAC is 10 bits
+#define SYNTH_MID		512		// The DAC value for silence
+#define SYNTH_NOTES		48		// Note numbers 1-48, C4 to B7
+#define SYNTH_VOICES	4		// Voices mixed into the output
+#define SYNTH_GAIN_BITS	8		// Fraction bits of a voice's gain and envelope level
+#define SYNTH_GAIN		(1 << SYNTH_GAIN_BITS)	// Gain of a voice at full volume
+#define SYNTH_TICK		32		// Samples between steps of the envelopes, 1.6 ms
+
+#define SYNTH_SINE		0		// Wave shapes, see synthShape()
+#define SYNTH_SQUARE	1
+#define SYNTH_TRIANGLE	2
+#define SYNTH_SAW		3
+#define SYNTH_SHAPES	4
+
+#define SYNTH_PIANO		0		// Envelopes, see synthEnvelope()
+#define SYNTH_ORGAN		1
+#define SYNTH_ENVS		2
+#define SYNTH_FALL_MAX	8		// Ticks of the longest release
+
+// Phase step for a frequency in hundredths of a Hz, worked out by the compiler
+#define SYNTH_STEP(hz100)	(uint32_t)(((uint64_t)(hz100) << 32) / (SYNTH_RATE*100ull))
+
+// The length in ms of the longest release, for the last note to die away
+#define SYNTH_FALL_MS	((SYNTH_FALL_MAX*SYNTH_TICK*1000 + SYNTH_RATE-1) / SYNTH_RATE)
+
+typedef struct {
+	const uint16_t	*rise;		// The level at each tick from the note on, the attack then the decay
+	int				riseLen;	// Ticks in rise
+	uint16_t		sustain;	// The level held after the decay until the note off
+	const uint16_t	*fall;		// The release, the scale of the level at the note off at each tick
+	int				fallLen;	// Ticks in fall, at most SYNTH_FALL_MAX
+} SYNTH_ENV;
+
+typedef struct {
+	uint32_t			phase;		// The phase of the oscillator
+	uint32_t			step;		// The phase step per sample
+	volatile int32_t	gain;		// The volume, SYNTH_GAIN for full
+	const int16_t		*wave;		// The wavetable
+	const SYNTH_ENV		*env;		// The envelope
+	int					stage;		// Where in the envelope, SYNTH_OFF to SYNTH_FALL
+	int					pos;		// The tick of the rise or fall
+	int32_t				level;		// The envelope level, SYNTH_GAIN for full
+	int32_t				held;		// The level at the note off
+	volatile uint32_t	next;		// The step of the next note on
+	volatile int		event;		// A note on or off not yet started, see synthStep()
+} SYNTH_VOICE;
+
+extern const int16_t	synthWaves[SYNTH_SHAPES][SYNTH_WAVE];
+extern const SYNTH_ENV	synthEnvs[SYNTH_ENVS];
+extern const uint32_t	synthSteps[SYNTH_NOTES+1];
+extern SYNTH_VOICE		synthVoices[SYNTH_VOICES];
+
+void synthNote(int voice, int note);
+void synthStep(int voice, uint32_t step);
+void synthGain(int voice, int gain);
+void synthShape(int voice, int shape);
+void synthEnvelope(int voice, int env);
+void synthRender(uint32_t *out, int n);
+#endif
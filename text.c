@@ -17,63 +17,177 @@
 #include "mysys.h"
 #include "text.h"
 #include "menu.h"
+#include "crc.h"
+#include "arena.h"
 
 #define TSTART	0x18009440
 #define TEXT	0x18006440
 #define TEND	0x1800A440
+#define TCHECK	0x18004440
 
 #define MSTART	0x1C009440
 #define RTTTL	0x1C006440
 #define MEND	0x1C00A440
+#define MCHECK	0x1C004440
+
+#define TACK	0x1400E440		// Text acknowledgement from bench 07
+
+#define TX_TRIES	100000		// Attempts to find a free transmit buffer
+#define ACK_TIMEOUT	200			// Time in ms to wait for an acknowledgement
+#define ACK_RETRIES	10			// Timeouts in a row before giving up
+#define PROBE_TRIES	300			// Window probes before giving up on a full receiver, a minute
 
 uint8_t 		*dataArray;		// Pointer to the dataArray
+uint32_t		rxSize = 0;		// The number of payload bytes dataArray can hold
+uint32_t		rxBase = 0;		// The dataArray offset of the current segment
+int				segment = 0;	// The segment expected next in an extended transfer
+uint32_t		rxCrc = 0;		// The CRC of the blocks received so far
+int				rxCheck = 0;	// 1 if the checksum matched, -1 if not, 0 if none received
+uint8_t			rxFormat = 0;	// The payload format of the transfer being received
+uint32_t		rxMark = 0;		// The decode arena position before dataArray
+uint8_t			rxHeap = 0;		// 1 if dataArray is from MSYS_Alloc(), being too big for the arena
+uint32_t		txCrc = 0;		// The CRC of the blocks being sent
+uint8_t			*txStr;			// The data being sent
+uint32_t		txLen;			// The number of bytes being sent
+uint32_t		txBlocks;		// The number of blocks being sent
+uint32_t		txTotal;		// The total length announced, 0 unless extended
+uint32_t		txData;			// The text block template with the target address added
+uint32_t		txStart;		// The start block template with the target address added
+uint8_t			txFlags;		// The flags sent in the start block
+uint8_t			txFormat;		// The payload format sent in the start block
+volatile int	txTarget = 0;	// The station an acknowledged transfer is being sent to
+volatile uint32_t txAcked = 0;	// The number of blocks the receiver has acknowledged
+volatile int	txWindow = 0;	// The window last granted by the receiver
+volatile int	txAckEvent = 0;	// Set when an acknowledgement arrives
+uint32_t		txNotes[2];		// The stations that take note streams, a bit each (see tx_ack())
+int				ackActive = 0;	// 1 while an acknowledged transfer is being received
+int				ackSource;		// The station sending the acknowledged transfer
+uint32_t		ackNext;		// The next block expected in the acknowledged transfer
+uint32_t		ackSeg;			// The segment the acknowledged transfer is in
+uint32_t		ackBlocks;		// The number of blocks in the acknowledged transfer
+uint32_t		ackLast;		// The block count last acknowledged
+uint32_t		ackEvery = 1;	// Blocks to receive between acknowledgements
+CAN_MSG_Type	AckMsg;			// Stores the acknowledgement to be sent
 int				count;			// Holds the number of blocks
 int 			i;		
 extern int		morseEnable;	// A flag, 1 if morse is enables, 0 otherwise
+extern int		chimeEnable;	// A flag, 1 if a chime is played for a text message, 0 otherwise
 int				rtttl= 0;		// RTTTL flag
 CAN_MSG_Type	Msg;			// Stores the message to be sent
 
+/*	
+ *	rx_release() gives back the array of the message being received, and 
+ *	everything allocated from the decode arena since it was made.
+ */
+static void rx_release()
+{
+	if(rxHeap) MSYS_Free(dataArray);
+	arenaReset(&decodeArena, rxMark);
+	dataArray = 0;
+	rxHeap = 0;
+}
+
 /*	
  *	init_text() is called when a start message block is received. It gets the 
  *	number of text blocks that will follow, from the block count part of the 
  *	start message header, and creates an array to store the expected data.
+ *
+ *	If the start block carries a total length in dataA the transfer is an 
+ *	extended one, split into segments of up to 255 blocks. The array is then 
+ *	sized from the total length when the first segment starts and each 
+ *	following segment is placed after the previous one.
+ *	
+ *	The array comes from the decode arena, unless the transfer is more than 
+ *	DECODE_MAX bytes (about 500 blocks). A longer one is reassembled in a 
+ *	block from MSYS_Alloc() instead, so its size is limited only by the free 
+ *	heap.
  *	
  *	@param	msg			The start block received
  */
-void init_text(CAN_MSG_Type msg)
+void init_text(const CAN_MSG_Type *msg)
 {
-	count = CAN_GET_COUNT(msg.id);
+	uint32_t total	= msg->dataA[0] | (msg->dataA[1] << 8) | (msg->dataA[2] << 16) | (msg->dataA[3] << 24);
+	int seg			= msg->dataB[0] | (msg->dataB[1] << 8);
+	
+	count = CAN_GET_COUNT(msg->id);
 	i = 0;
 	if(count == 0)
 	{
 		write_usb_serial_blocking("Error! Block count is 0\n\r",27);
+		return;
 	}
-	else
+	
+	UARTPutDec16((LPC_UART_TypeDef *)LPC_UART0, count);
+	
+	if(total != 0 && seg != 0)			// Continuing an extended transfer
 	{
-		UARTPutDec16((LPC_UART_TypeDef *)LPC_UART0, count);
-		dataArray = MSYS_Alloc(sizeof(*dataArray) *(count*8));
+		if(dataArray == 0 || seg != segment)
+		{
+			write_usb_serial_blocking("Error! Segment out of order\n\r",31);
+			if(dataArray) rx_release();
+			return;
+		}
+		rxBase = seg*TEXT_SEG_BYTES;
+		segment++;
+		return;
 	}
+	
+	if(dataArray) rx_release();			// Drop any transfer that never ended
+	
+	rxSize = (total != 0) ? total : count*8;
+	rxBase = 0;
+	segment = 1;
+	rxCrc = 0;
+	rxCheck = 0;
+	rxFormat = msg->dataB[3];
+	
+	// One spare byte so the received data is always a terminated string. The 
+	// array and all the decoding of it come from the decode arena, and are 
+	// released together by end_text()
+	rxMark = arenaMark(&decodeArena);
+	rxHeap = (rxSize > DECODE_MAX);
+	if(rxHeap)	dataArray = MSYS_Alloc(sizeof(*dataArray) * (rxSize+1));
+	else		dataArray = arenaAlloc(&decodeArena, sizeof(*dataArray) * (rxSize+1));
+	if(dataArray == 0)
+	{
+		write_usb_serial_blocking("Error! Out of memory\n\r",24);
+		rxHeap = 0;
+		return;
+	}
+	memset(dataArray, 0, rxSize+1);
 }
 
 /*	
  *	rx_text() deals with received RTTTL and text messages. For text messages 
  *	it iterates over the 2 4-element arrays in each text block and stores the 
- *	contained values into the main dataArray array.
+ *	contained values into the main dataArray array. The block number in the 
+ *	header gives the position of the block within the current segment, blocks 
+ *	that would fall outside the array are dropped.
+ *
+ *	Each block is added to the running CRC as it arrives, in the order it 
+ *	arrives, so a lost or misordered block shows up as a checksum mismatch.
  *	
  *	@param	msg			The text block received
  *	@return	dataArray	The array where the received data is stored
  */
-uint8_t* rx_text(CAN_MSG_Type msg)
+uint8_t* rx_text(const CAN_MSG_Type *msg)
 {	
+	uint32_t pos = rxBase + 8*CAN_GET_COUNT(msg->id);
 	int j=0,k=0;
-	for(j=0; j<4; j++)
+	
+	if(dataArray == 0) return 0;
+	
+	rxCrc = crc32_update(rxCrc, msg->dataA, 4);
+	rxCrc = crc32_update(rxCrc, msg->dataB, 4);
+	
+	for(j=0; j<4 && (pos+j)<rxSize; j++)
 	{
-		dataArray[(8*i)+j] = msg.dataA[j];
+		dataArray[pos+j] = msg->dataA[j];
 	}
 
-	for(k=0; k<4; k++)
+	for(k=0; k<4 && (pos+k+4)<rxSize; k++)
 	{
-		dataArray[(8*i)+(k+4)] = msg.dataB[k];
+		dataArray[pos+k+4] = msg->dataB[k];
 	}
 
 	i++;
@@ -82,107 +196,371 @@ uint8_t* rx_text(CAN_MSG_Type msg)
 }
 
 /*	
- *	tx_text() receives a string and destination address and composes the blocks 
- *	needed to send the string as either a text or RTTTL message over the network.
- *	Further detail is given by inline comments.
+ *	check_text() is called when a checksum block is received during a transfer. 
+ *	The CRC in dataA is compared with the CRC of the blocks received so far 
+ *	and the result is kept for end_text().
+ *	
+ *	@param	msg			The checksum block received
+ */
+void check_text(const CAN_MSG_Type *msg)
+{
+	uint32_t crc = msg->dataA[0] | (msg->dataA[1] << 8) | (msg->dataA[2] << 16) | (msg->dataA[3] << 24);
+	
+	if(dataArray == 0) return;			// Not part of a transfer
+	
+	rxCheck = (crc == rxCrc) ? 1 : -1;
+}
+
+static void tx_start(int seg);
+
+/*	
+ *	tx_frame() sends the outgoing message, waiting for a free transmit buffer 
+ *	if all 3 are in use, as they will be when blocks are sent back to back.
+ *	
+ *	The CAN interrupt sends acknowledgements (see rx_ack()) and the Timer1 
+ *	interrupt the 'I am online' reply, on the same controller. Either could 
+ *	take the transmit buffer CAN_SendMsg() has just found free, and this 
+ *	message would be lost though SUCCESS is returned, so both are held off 
+ *	while it is sent.
+ *	
+ *	@return				SUCCESS if the message was sent, ERROR if not
+ */
+static Status tx_frame()
+{
+	int tries = 0;
+	Status sent;
+	
+	do
+	{
+		NVIC_DisableIRQ(CAN_IRQn);
+		NVIC_DisableIRQ(TIMER1_IRQn);
+		sent = CAN_SendMsg(LPC_CAN2, &Msg);
+		NVIC_EnableIRQ(TIMER1_IRQn);
+		NVIC_EnableIRQ(CAN_IRQn);
+	}
+	while(sent != SUCCESS && ++tries <= TX_TRIES);
+	return sent;
+}
+
+/*	
+ *	tx_block() fills the outgoing message with block b of the string being 
+ *	sent, zero padding any bytes past the end of it, sends it and prints its 
+ *	data to the terminal. When b is the first block of a later segment of an 
+ *	extended transfer, the start block for that segment is sent first.
+ *	
+ *	@param	b			The block number within the whole transfer
+ */
+static void tx_block(uint32_t b)
+{
+	uint32_t pos = b*8;
+	int m=0;
+	
+	if(b != 0 && (b % TEXT_SEG_BLOCKS) == 0)
+	{
+		tx_start(b / TEXT_SEG_BLOCKS);
+	}
+	
+	Msg.format	= EXT_ID_FORMAT;
+	Msg.id		= txData | ((b % TEXT_SEG_BLOCKS) << CANSHIFT_COUNT);	// Add the block number
+	Msg.len		= 8;	
+	Msg.type	= DATA_FRAME;
+	
+	for(m = 0; m<4; m++)
+	{
+		Msg.dataA[m] = (pos+m   < txLen) ? txStr[pos+m]   : 0;
+		Msg.dataB[m] = (pos+m+4 < txLen) ? txStr[pos+m+4] : 0;
+	}
+	
+	tx_frame();						// Send text block
+	
+	// Printing message data to screen
+	for(m = 0; m<4; m++)
+	{
+		UARTPutChar((LPC_UART_TypeDef *)LPC_UART0, Msg.dataA[m]);
+	}
+	for(m = 0; m<4; m++)
+	{
+		UARTPutChar((LPC_UART_TypeDef *)LPC_UART0, Msg.dataB[m]);
+	}
+}
+
+/*	
+ *	tx_start() sends the start of text block for a segment of the transfer. 
+ *	For a transfer that fits in 255 blocks the length and segment bytes are 
+ *	left at 0, otherwise they carry the total length and the segment number.
+ *	
+ *	@param	seg			The segment number
+ */
+static void tx_start(int seg)
+{
+	uint32_t left = txBlocks - seg*TEXT_SEG_BLOCKS;
+	
+	Msg.format	= EXT_ID_FORMAT;
+	Msg.id		= txStart | (((left > TEXT_SEG_BLOCKS) ? TEXT_SEG_BLOCKS : left) << CANSHIFT_COUNT);
+	Msg.len		= 8;	
+	Msg.type	= DATA_FRAME;
+	
+	Msg.dataA[0] = txTotal;
+	Msg.dataA[1] = txTotal >> 8;
+	Msg.dataA[2] = txTotal >> 16;
+	Msg.dataA[3] = txTotal >> 24;
+	Msg.dataB[0] = seg;
+	Msg.dataB[1] = seg >> 8;
+	Msg.dataB[2] = txFlags;
+	Msg.dataB[3] = txFormat;
+	
+	if(tx_frame() == SUCCESS)
+	{
+		pre(&Msg, 's');
+		write_usb_serial_blocking("Start of text block",19);
+		post(&Msg);
+	}
+	else write_usb_serial_blocking("Message not sent\n\r",18);
+}
+
+/*	
+ *	tx_wait() waits for an acknowledgement from the receiver, or for the 
+ *	timeout to pass.
+ *	
+ *	@return				1 if an acknowledgement arrived, 0 if timed out
+ */
+static int tx_wait()
+{
+	unsigned int start = ticks();
+	
+	while(!txAckEvent)
+	{
+		if((ticks() - start) > ACK_TIMEOUT) return 0;
+	}
+	txAckEvent = 0;
+	return 1;
+}
+
+/*	
+ *	tx_probe() asks the receiver for its window again, while it has granted 
+ *	none, with an acknowledgement carrying TEXT_ACK_PROBE.
+ */
+static void tx_probe()
+{
+	Msg.format	= EXT_ID_FORMAT;
+	Msg.id		= TACK | txTarget;
+	Msg.len		= 8;
+	Msg.type	= DATA_FRAME;
+	Msg.dataA[0] = txAcked;
+	Msg.dataA[1] = txAcked >> 8;
+	Msg.dataA[2] = txAcked >> 16;
+	Msg.dataA[3] = txAcked >> 24;
+	Msg.dataB[0] = 0;
+	Msg.dataB[1] = TEXT_ACK_PROBE;
+	Msg.dataB[2] = Msg.dataB[3] = 0;
+	
+	tx_frame();
+}
+
+/*	
+ *	tx_windowed() sends the blocks of an acknowledged transfer. Blocks are 
+ *	sent back to back while they fit in the window granted by the receiver. 
+ *	Each acknowledgement moves the window on to the blocks not yet received 
+ *	and sets its new size, so a receiver that is busy or has a full buffer 
+ *	slows the sender down by granting a smaller window, down to none. If no 
+ *	acknowledgement comes before the timeout, everything after the last block 
+ *	acknowledged is sent again, up to ACK_RETRIES times in a row.
+ *	
+ *	A receiver with a full buffer grants no window until its inbox is read, 
+ *	which may take a while. Meanwhile the window is probed (see tx_probe()) 
+ *	every ACK_TIMEOUT, for up to PROBE_TRIES times. Probes that are answered 
+ *	are not counted as retries, so a full receiver is waited for but one 
+ *	that has gone is given up on as before. A receiver grants no window when 
+ *	it has dropped a block for lack of room, so the blocks after the last one 
+ *	acknowledged are sent again once the window opens.
+ *	
+ *	@return				1 if every block was acknowledged, 0 if not
+ */
+static int tx_windowed()
+{
+	uint32_t base = txAcked;		// First block not yet acknowledged
+	uint32_t next = base;			// Next block to send
+	int tries = 0;
+	int probes = 0;					// Window probes sent while the window is closed
+	int probed = 0;					// 1 if the last probe has not been answered
+	
+	while(base < txBlocks)
+	{
+		while(next < txBlocks && next < base + txWindow)
+		{
+			tx_block(next);
+			next++;
+		}
+		
+		if(tx_wait())
+		{
+			probed = 0;
+			if(txAcked > base)
+			{
+				base = txAcked;
+				tries = 0;
+				probes = 0;
+			}
+			if(next < base || txWindow == 0) next = base;
+		}
+		else if(txWindow == 0)
+		{
+			if(probed && ++tries > ACK_RETRIES) return 0;
+			if(++probes > PROBE_TRIES) return 0;
+			tx_probe();
+			probed = 1;
+		}
+		else
+		{
+			if(++tries > ACK_RETRIES) return 0;
+			write_usb_serial_blocking("\n\rResending",12);
+			next = base;				// Go back to the first block not acknowledged
+		}
+	}
+	return 1;
+}
+
+/*	
+ *	tx_text() receives a string and destination address and sends the string, 
+ *	with its terminating character, as either a text or RTTTL message over 
+ *	the network.
  *	
  *	@param	str			The string to send
  *	@param	to			The number of the station to send to
  *	@param	type		't' if text message, 'r' if RTTTL
+ *	@return				1 if sent (and acknowledged if requested), 0 if not delivered
+ */
+int tx_text(char str[], int to, char type)
+{
+	return tx_data((uint8_t*)str, strlen(str)+1, to, type, TEXT_FORMAT_TEXT);
+}
+
+/*	
+ *	tx_ringtone() converts an RTTTL string to a binary note stream and sends 
+ *	that, which takes about a quarter of the blocks and saves the receiver 
+ *	from parsing it. Only a station that has said it can decode note streams, 
+ *	by TEXT_ACK_NOTES in its acknowledgement of an earlier transfer, is sent 
+ *	one. Any other station would take the stream for RTTTL text, so it is 
+ *	sent the RTTTL string, as is a broadcast, which is not acknowledged, and 
+ *	a string that can not be converted.
+ *	
+ *	@param	str			The RTTTL string to send
+ *	@param	to			The number of the station to send to
+ *	@return				1 if sent (and acknowledged if requested), 0 if not delivered
+ */
+int tx_ringtone(char str[], int to)
+{
+	int size = strlen(str)+8;
+	uint8_t *notes = 0;
+	int len = 0;
+	int sent;
+	
+	if(to != 0 && (txNotes[to >> 5] & (1u << (to & 31))))
+	{
+		notes = MSYS_Alloc(size);
+		if(notes) len = rtttlEncode(str, notes, size);
+	}
+	
+	if(len > 0) sent = tx_data(notes, len, to, 'r', TEXT_FORMAT_NOTES);
+	else sent = tx_text(str, to, 'r');
+	
+	if(notes) MSYS_Free(notes);
+	return sent;
+}
+
+/*	
+ *	tx_data() receives the data and destination address and composes the blocks 
+ *	needed to send it as either a text or RTTTL message over the network.
+ *	Data that needs more than 255 blocks is sent as an extended transfer, a 
+ *	series of segments of up to 255 blocks each with its own start block. After 
+ *	the last block a checksum block carries the CRC32 of all of the blocks sent, 
+ *	in dataA, so the receiver can check the data before using it. Further detail 
+ *	is given by inline comments.
+ *
+ *	Messages to a single station ask for an acknowledged transfer. If the 
+ *	receiver answers the start block with a window, the blocks are sent by 
+ *	tx_windowed(). If it does not answer within ACK_TIMEOUT, it is assumed to 
+ *	be a station that does not support acknowledgements and the blocks are 
+ *	sent without. The start block is only sent once, as such a station 
+ *	starts a new transfer for every start block it receives. If it was only 
+ *	the answer that was lost, the receiver still takes the blocks sent 
+ *	without acknowledgements, as they arrive in order.
+ *	
+ *	@param	str			The data to send
+ *	@param	len			The number of bytes to send
+ *	@param	to			The number of the station to send to
+ *	@param	type		't' if text message, 'r' if RTTTL
+ *	@param	format		The payload format, TEXT_FORMAT_TEXT or TEXT_FORMAT_NOTES
+ *	@return				1 if sent (and acknowledged if requested), 0 if not delivered
  */
-void tx_text(char str[], int to, char type)
+int tx_data(uint8_t str[], uint32_t len, int to, char type, uint8_t format)
 {	
-	int count = (strlen(str)/8)+1;			// The number of text blocks needed
+	static const uint8_t pad[8] = {0};
+	uint32_t b = 0;
+	int delivered = 1;
+	
+	txStr		= str;
+	txLen		= len;
+	txBlocks	= (txLen+7)/8;						// The number of text blocks needed
+	txFormat	= format;
+	txFlags		= (to != 0) ? TEXT_FLAG_ACK : 0;	// No acknowledgements from a broadcast
+	txTarget	= to;
+	
+	// The total length is only sent for extended transfers, and binary data 
+	// which can not rely on a terminating character
+	txTotal		= (txBlocks > TEXT_SEG_BLOCKS || format != TEXT_FORMAT_TEXT) ? txLen : 0;
+	
+	// The CRC covers every byte of every block, including the padding
+	txCrc = crc32_update(0, str, txLen);
+	txCrc = crc32_update(txCrc, pad, txBlocks*8 - txLen);
 	
-	uint32_t data;
-	uint32_t start;
+	uint32_t check;
 	uint32_t end;
 	
 	if(type == 'r') 		// If sending RTTTL
 	{
-		data	= RTTTL;
-		start	= MSTART;
+		txData	= RTTTL | to;
+		txStart	= MSTART | to;
+		check	= MCHECK;
 		end		= MEND;
 	}
 	else 					// Else, must be sending TEXT
 	{
-		data 	= TEXT;
-		start 	= TSTART;
+		txData 	= TEXT | to;
+		txStart	= TSTART | to;
+		check	= TCHECK;
 		end 	= TEND;
 	}						
 	
 	//-------------------------START OF TEXT BLOCK-------------------------//
-	int tmp1 = (start | (count << 18));		// Add the block count
-	int stmp = (tmp1 | to);					// Then a dash of target address
-	send_CAN(stmp, DATA_FRAME, 0, 0);		// And serve to the CAN bus
+	txAcked = 0;
+	txAckEvent = 0;
+	tx_start(0);
 	
 	//-----------------------------TEXT BLOCK-----------------------------//
-	int ttmp1 = (data | to);				// Add the target address to text block template	
-	dataArray = Msg.dataA;					// txDataArray initially points the dataA array
-	unsigned char i=0, j=0;					// i is the character count, j the block count
-	for(i=0;i<strlen(str);i++)
+	if(txFlags && tx_wait())
 	{
-		if((i%8 == 0) && (i != 0))			// Don't want this to execute when i = 0, ie the first block
-		{
-			int ttmp = (ttmp1 | (j << 18));	// Add the block number to the text id
-			
-			Msg.format	= EXT_ID_FORMAT;
-			Msg.id		= ttmp;
-			Msg.len		= 8;	
-			Msg.type	= DATA_FRAME;
-			
-			CAN_SendMsg(LPC_CAN2, &Msg);	// Send text block
-			
-			// Printing message data to screen
-			int m=0;
-			for(m = 0; m<4; m++)
-			{
-				UARTPutChar((LPC_UART_TypeDef *)LPC_UART0, Msg.dataA[m]);
-			}
-			for(m = 0; m<4; m++)
-			{
-				UARTPutChar((LPC_UART_TypeDef *)LPC_UART0, Msg.dataB[m]);
-			}
-
-			// Clearing message data
-			Msg.dataA[0] = Msg.dataA[1] = Msg.dataA[2] = Msg.dataA[3] = 0;
-			Msg.dataB[0] = Msg.dataB[1] = Msg.dataB[2] = Msg.dataB[3] = 0;
-			
-			j++;							// Increment the block number (ie new block)
-			dataArray = Msg.dataA;			// Set array to data Array
-			dataArray[i%4] = str[i];		// Add input character to the current array				
-		}
-		else if((i%4 == 0) && (i != 0))
-		{
-			dataArray = Msg.dataB;		// txDataArray now points the dataB array
-			dataArray[i%4] = str[i];	// Add input character to the current array
-		}
-		else
-		{
-			dataArray[i%4] = str[i];		// Add input character to the current array
-		}
+		delivered = tx_windowed();
+	}
+	else
+	{
+		for(b=0; b<txBlocks; b++) tx_block(b);
 	}
+	txTarget = 0;
 	
-	// This is executed when the string is finished, to deal with partials
-	int ttmpp = (ttmp1 | (j << 18));// Add the block number to the text id
-			
+	//---------------------------CHECKSUM BLOCK---------------------------//
 	Msg.format	= EXT_ID_FORMAT;	
-	Msg.id		= ttmpp;	
+	Msg.id		= (check | to);
 	Msg.len		= 8;	
 	Msg.type	= DATA_FRAME;
-
-	CAN_SendMsg(LPC_CAN2, &Msg);	// Send end of text
-
-	int m=0;
-	for(m = 0; m<4; m++)
-	{
-		UARTPutChar((LPC_UART_TypeDef *)LPC_UART0, Msg.dataA[m]);
-	}
-	for(m = 0; m<4; m++)
-	{
-		UARTPutChar((LPC_UART_TypeDef *)LPC_UART0, Msg.dataB[m]);
-	}
-
+	Msg.dataA[0] = txCrc;
+	Msg.dataA[1] = txCrc >> 8;
+	Msg.dataA[2] = txCrc >> 16;
+	Msg.dataA[3] = txCrc >> 24;
+	Msg.dataB[0] = Msg.dataB[1] = Msg.dataB[2] = Msg.dataB[3] = 0;
+	
+	tx_frame();						// Send checksum block
+	
 	//-------------------------END OF TEXT BLOCK-------------------------//
 	write_usb_serial_blocking("\n\r",4);
 	
@@ -190,13 +568,14 @@ void tx_text(char str[], int to, char type)
 	Msg.id		= (end | to);
 	Msg.len		= 8;	
 	Msg.type	= DATA_FRAME;
+	Msg.dataA[0] = Msg.dataA[1] = Msg.dataA[2] = Msg.dataA[3] = 0;
 
-	CAN_SendMsg(LPC_CAN2, &Msg);	// Send end block
+	tx_frame();						// Send end block
 	
 	write_usb_serial_blocking(" ",1);
-	UARTPutDec((LPC_UART_TypeDef *)LPC_UART0, j);
+	UARTPutDec16((LPC_UART_TypeDef *)LPC_UART0, txBlocks);
 	write_usb_serial_blocking("\n\n\r",4);
-	pre(Msg, 's');
+	pre(&Msg, 's');
 	write_usb_serial_blocking("End of text block",17);
 	write_usb_serial_blocking(" '",2);
 	write_usb_serial_blocking("'",1);
@@ -204,48 +583,249 @@ void tx_text(char str[], int to, char type)
 	write_usb_serial_blocking("Message id: \t",13);
 	UARTPutHex32((LPC_UART_TypeDef *)LPC_UART0, Msg.id);
 	write_usb_serial_blocking("\t",2);
-	MSYS_Free(dataArray);
-	
 	
-	post(Msg);
+	post(&Msg);
+	if(!delivered) write_usb_serial_blocking("Not acknowledged\n\r",18);
 	write_usb_serial_blocking("******\n\r",10);
+	
+	return delivered;
 }
 
+/*	
+ *	tx_ack() is called from the CAN interrupt when an acknowledgement arrives 
+ *	for the transfer being sent. It records how many blocks the receiver has 
+ *	and the window it has granted for tx_windowed(), and whether it can 
+ *	decode note streams for tx_ringtone().
+ *	
+ *	@param	msg			The acknowledgement received
+ */
+void tx_ack(const CAN_MSG_Type *msg)
+{
+	uint32_t acked = msg->dataA[0] | (msg->dataA[1] << 8) | (msg->dataA[2] << 16) | (msg->dataA[3] << 24);
+	
+	if(txTarget == 0 || CAN_GET_SOURCE_ADD(msg->id) != txTarget) return;
+	
+	if(acked > txAcked) txAcked = acked;
+	txWindow = msg->dataB[0];
+	if(msg->dataB[1] & TEXT_ACK_NOTES)	txNotes[txTarget >> 5] |= 1u << (txTarget & 31);
+	else								txNotes[txTarget >> 5] &= ~(1u << (txTarget & 31));
+	txAckEvent = 1;
+}
+
+/*	
+ *	rx_ack() sends an acknowledgement for the acknowledged transfer being 
+ *	received. The window granted is the space left in the receive buffer, 
+ *	keeping 2 places back for the checksum and end blocks.
+ */
+static void rx_ack()
+{
+	int window = bufferFree() - 2;
+	
+	if(window < 0) window = 0;
+	if(window > TEXT_WINDOW) window = TEXT_WINDOW;
+	
+	AckMsg.format	= EXT_ID_FORMAT;
+	AckMsg.id		= TACK | ackSource;
+	AckMsg.len		= 8;
+	AckMsg.type		= DATA_FRAME;
+	AckMsg.dataA[0] = ackNext;
+	AckMsg.dataA[1] = ackNext >> 8;
+	AckMsg.dataA[2] = ackNext >> 16;
+	AckMsg.dataA[3] = ackNext >> 24;
+	AckMsg.dataB[0] = window;
+	AckMsg.dataB[1] = TEXT_ACK_NOTES;	// Ringtones can be sent as note streams
+	AckMsg.dataB[2] = AckMsg.dataB[3] = 0;
+	
+	CAN_SendMsg(LPC_CAN2, &AckMsg);
+	
+	ackLast = ackNext;
+	ackEvery = (window > 1) ? window/2 : 1;
+}
+
+/*	
+ *	rx_flow() is called from the CAN interrupt for every message received, 
+ *	before it is buffered. It handles the receiving end of acknowledged 
+ *	transfers: only the next block expected is kept, so anything sent 
+ *	again is not buffered twice, and an acknowledgement is sent every half 
+ *	window, at the end of each segment, whenever a block arrives that was 
+ *	not expected and when the sender probes the window. Acknowledgements 
+ *	for our own transfers are passed to tx_ack(). Messages that are not 
+ *	part of an acknowledged transfer are left alone.
+ *	
+ *	The acceptance filter passes every message on the bus, so transfers 
+ *	between other stations are seen too. Only messages addressed to this 
+ *	station are acknowledged, or the acknowledgements would be mixed up 
+ *	with those of the real receiver.
+ *	
+ *	A block or segment start that arrives when the receive buffer is full 
+ *	is not taken, as the CAN interrupt would have to drop it. The last good 
+ *	block is acknowledged again with a window of 0, so the sender goes back 
+ *	to it once the buffer is emptied (see rx_window()).
+ *	
+ *	@param	msg			The message received
+ *	@return				1 if the message should be buffered, 0 if not
+ */
+int rx_flow(const CAN_MSG_Type *msg)
+{
+	int cmd = CAN_GET_CMD(msg->id);
+	int src = CAN_GET_SOURCE_ADD(msg->id);
+	uint32_t b;
+	
+	if(CAN_GET_TARGET_ADD(msg->id) != CANADD_SELF)
+	{
+		return cmd != CMD_TEXTACK;	// Another station's transfer
+	}
+	
+	if(cmd == CMD_TEXTACK)
+	{
+		if(!(msg->dataB[1] & TEXT_ACK_PROBE))	tx_ack(msg);
+		else if(ackActive && src == ackSource)	rx_ack();	// The sender is waiting for the window
+		return 0;
+	}
+	
+	if(cmd == CMD_STEXT && (msg->dataB[2] & TEXT_FLAG_ACK))
+	{
+		uint32_t total = msg->dataA[0] | (msg->dataA[1] << 8) | (msg->dataA[2] << 16) | (msg->dataA[3] << 24);
+		uint32_t seg = msg->dataB[0] | (msg->dataB[1] << 8);
+		
+		if(seg == 0)
+		{
+			if(bufferFree() == 0) return 0;	// No room, the sender falls back to an unacknowledged transfer
+			ackActive	= 1;
+			ackSource	= src;
+			ackNext		= 0;
+			ackSeg		= 0;
+			ackBlocks	= total ? (total+7)/8 : CAN_GET_COUNT(msg->id);
+			rx_ack();
+			return 1;
+		}
+		if(ackActive && src == ackSource && seg > ackSeg && seg*TEXT_SEG_BLOCKS == ackNext)
+		{
+			if(bufferFree() == 0)
+			{
+				rx_ack();			// No room for it, the window is 0
+				return 0;
+			}
+			ackSeg = seg;
+			return 1;
+		}
+		return 0;
+	}
+	
+	if(!ackActive || src != ackSource) return 1;
+	
+	if(cmd == CMD_TEXTBLOCK)
+	{
+		b = ackSeg*TEXT_SEG_BLOCKS + CAN_GET_COUNT(msg->id);
+		if(b != ackNext)
+		{
+			rx_ack();				// Tell the sender where we are
+			return 0;
+		}
+		if(bufferFree() == 0)
+		{
+			rx_ack();				// No room for it, the window is 0
+			return 0;
+		}
+		ackNext++;
+		if((ackNext - ackLast) >= ackEvery || ackNext == ackBlocks || (ackNext % TEXT_SEG_BLOCKS) == 0)
+		{
+			rx_ack();
+		}
+		return 1;
+	}
+	
+	if(cmd == CMD_ETEXT) ackActive = 0;
+	
+	return 1;
+}
+
+/*	
+ *	rx_window() is called when the receive buffer has been emptied. If an 
+ *	acknowledged transfer is being received, the sender is told that the 
+ *	window is open again.
+ *	
+ *	rx_ack() is otherwise called from the CAN interrupt, so that and the 
+ *	Timer1 interrupt are held off while it builds and sends AckMsg, as in 
+ *	tx_frame().
+ */
+void rx_window()
+{
+	NVIC_DisableIRQ(CAN_IRQn);
+	NVIC_DisableIRQ(TIMER1_IRQn);
+	if(ackActive) rx_ack();
+	NVIC_EnableIRQ(TIMER1_IRQn);
+	NVIC_EnableIRQ(CAN_IRQn);
+}
+
+#ifdef MSYS_STATS
+/*	
+ *	heap_line() prints a line of the heap dump to the terminal.
+ *	
+ *	@param	line		The line to print
+ */
+static void heap_line(const char *line)
+{
+	write_usb_serial_blocking((char*)line, strlen(line));
+}
+#endif
+
 /*	
  *	end_text() is called when the end of text message block is received. 
  *	When this happens the data that has been stored in the dataArray is 
  *	dealt with. For a text message, this is printed out to the terminal 
  *	and the LCD. For an RTTTL message the data is passed to the RTTTL 
  *	handler for parsing. If morse code mode is enabled, the received text 
- *	messages are parsed to morse code.
+ *	messages are parsed to morse code, otherwise if the message chime is 
+ *	enabled (see menu.c) a chime is played over any ringtone playing.
+ *
+ *	If a checksum block was received and did not match, the data is thrown 
+ *	away. Senders that do not send a checksum are still accepted.
  *	
  *	@param	msg			The received end of text message block
  */
-void end_text(CAN_MSG_Type msg)
+void end_text(const CAN_MSG_Type *msg)
 {
 	int l = 0;
+	
+	if(dataArray == 0) return;			// Nothing was received
+	
 	write_usb_serial_blocking(" '",2);
-	if(CAN_GET_TYPE(msg.id) == MMSDATA)
+	if(rxCheck == -1)
+	{
+		write_usb_serial_blocking("Checksum error, message dropped",31);
+	}
+	else if(CAN_GET_TYPE(msg->id) == MMSDATA && rxFormat == TEXT_FORMAT_NOTES)
+	{
+		notesDecode(dataArray, rxSize);
+		write_usb_serial_blocking("Received ringtone notes",23);
+	}
+	else if(CAN_GET_TYPE(msg->id) == MMSDATA)
 	{
 		rtttlDecode((char*)dataArray);
 		rtttl = 0;
 		write_usb_serial_blocking("Received RTTTL message",22);
 	}
-	else if(CAN_GET_TYPE(msg.id) == VOICEDATA)
+	else if(CAN_GET_TYPE(msg->id) == VOICEDATA)
 	{
 		// Yet to be implemented
 	}
-	else if(CAN_GET_TYPE(msg.id) == SMSDATA)
+	else if(CAN_GET_TYPE(msg->id) == SMSDATA)
 	{
-		for(l=0; l<(count*8); l++)
+		for(l=0; l<rxSize; l++)
 		{
 			UARTPutChar((LPC_UART_TypeDef *)LPC_UART0, dataArray[l]);
 		}
 		write_usb_serial_blocking("\n\r",2);
 		clear_screen();
-		lcdTextMsg((char*)dataArray, (count*8));
+		lcdTextMsg((char*)dataArray, rxSize);
 		if(morseEnable) morseParse((char*)dataArray);
+		else if(chimeEnable) notify();
 	}
 	write_usb_serial_blocking("'",1);
-	MSYS_Free(dataArray);
+	rx_release();
+#ifdef MSYS_STATS
+	write_usb_serial_blocking("\n\r",2);
+	MSYS_Dump(heap_line);
+#endif
 }
@@ -2,7 +2,13 @@
  *	@author		abradbury
  */
 
-void init_text(CAN_MSG_Type msg);
-uint8_t* rx_text(CAN_MSG_Type msg);
-void tx_text(char str[], int to, char type);
-void end_text(CAN_MSG_Type msg);
+void init_text(const CAN_MSG_Type *msg);
+uint8_t* rx_text(const CAN_MSG_Type *msg);
+void check_text(const CAN_MSG_Type *msg);
+int tx_text(char str[], int to, char type);
+int tx_ringtone(char str[], int to);
+int tx_data(uint8_t str[], uint32_t len, int to, char type, uint8_t format);
+void tx_ack(const CAN_MSG_Type *msg);
+int rx_flow(const CAN_MSG_Type *msg);
+void rx_window();
+void end_text(const CAN_MSG_Type *msg);
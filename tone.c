@@ -0,0 +1,151 @@
+/*
+ *	@author		abradbury
+ *
+ *	Tone.c keeps the ringtones that have been compiled, so one that is played
+ *	again does not have to be parsed again. A ringtone, from RTTTL text or a
+ *	received note stream, is compiled by music.c into a list of note events,
+ *	each the note number (see toneNote()) and its length in milliseconds,
+ *	which is all play() needs.
+ *
+ *	A compiled ringtone is found by a hash of the text or stream it was
+ *	compiled from, so the same ringtone played from the menu, or received
+ *	again, is found whatever its name. The text and note stream of the same
+ *	ringtone hash differently, so are kept separately. TONE_CACHE ringtones
+ *	are kept, with the events on the MSYS heap; when the cache is full the
+ *	one played longest ago is replaced.
+ */
+
+#include "tone.h"
+#include "mysys.h"
+
+TONE_Type		tones[TONE_CACHE];	// The compiled ringtones
+uint32_t		toneClock = 0;		// Counts finds and compiles, to order the entries by use
+
+/*
+ *	toneHash() gives the 32 bit FNV-1a hash of some data.
+ *
+ *	@param	data		The data to hash
+ *	@param	len			The number of bytes
+ *	@return				The hash
+ */
+uint32_t toneHash(const uint8_t *data, int len)
+{
+	uint32_t hash = 2166136261u;
+
+	while(len-- > 0)
+	{
+		hash ^= *data++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*
+ *	toneFind() looks for a compiled ringtone.
+ *
+ *	@param	hash		The hash of the text or note stream, from toneHash()
+ *	@return				The ringtone, or 0 if it has not been compiled
+ */
+TONE_Type* toneFind(uint32_t hash)
+{
+	int e;
+
+	for(e=0; e<TONE_CACHE; e++)
+	{
+		if(tones[e].used && tones[e].hash == hash)
+		{
+			tones[e].used = ++toneClock;
+			return &tones[e];
+		}
+	}
+	return 0;
+}
+
+/*
+ *	toneNew() makes an entry for a ringtone about to be compiled, with room
+ *	for count events. The entry used longest ago is replaced if there is no
+ *	free one, and if the heap is too full for the events the other entries
+ *	are freed to make room.
+ *
+ *	@param	hash		The hash of the text or note stream
+ *	@param	count		The most events the ringtone can have
+ *	@return				The entry, with count and name to be filled in, or 0
+ *						if there is not enough memory
+ */
+TONE_Type* toneNew(uint32_t hash, int count)
+{
+	TONE_Type *tone = &tones[0];
+	int e;
+
+	for(e=1; e<TONE_CACHE; e++)
+	{
+		if(tones[e].used < tone->used) tone = &tones[e];
+	}
+	toneDrop(tone);
+
+	tone->events = MSYS_Alloc(count*sizeof(NOTE_EVENT));
+	for(e=0; e<TONE_CACHE && tone->events == 0; e++)
+	{
+		toneDrop(&tones[e]);
+		tone->events = MSYS_Alloc(count*sizeof(NOTE_EVENT));
+	}
+	if(tone->events == 0) return 0;
+
+	tone->hash = hash;
+	tone->used = ++toneClock;
+	tone->count = 0;
+	tone->name[0] = '\0';
+	return tone;
+}
+
+/*
+ *	toneDrop() removes a ringtone from the cache and frees its events, for
+ *	example if it could not be compiled.
+ *
+ *	@param	tone		The entry to remove
+ */
+void toneDrop(TONE_Type *tone)
+{
+	if(tone->events) MSYS_Free(tone->events);
+	tone->events = 0;
+	tone->used = 0;
+	tone->count = 0;
+}
+
+/*
+ *	toneNote() gives the note number of a note, which says what it is to the
+ *	synthesiser (see synth.c). Octaves outside 4 to 7 are played in the 4th
+ *	octave.
+ *
+ *	@param	pitch		0 for a pause, 1-12 for C to B
+ *	@param	octave		The octave of the note
+ *	@return				1-48 for C4 to B7, 0 for a pause
+ */
+int toneNote(int pitch, int octave)
+{
+	if(pitch < 1 || pitch > 12) return 0;
+	if(octave < 4 || octave > 7) octave = 4;
+	return (octave-4)*12 + pitch;
+}
+
+/*
+ *	toneTicks() gives the length of a note in milliseconds. A beat is one
+ *	note of the default duration, so a note lasts beat/dur beats of
+ *	60000/bpm ms each, and half as long again if it is dotted. It is done
+ *	in integers, with the dot as 3/2, to the same millisecond the floating
+ *	point sum gave.
+ *
+ *	@param	dur			The duration of the note, eg 8 for a quaver
+ *	@param	dot			1 if the note is dotted, 0 otherwise
+ *	@param	beat		The default duration
+ *	@param	bpm			The beats per minute
+ *	@return				The length in milliseconds, at most 65535
+ */
+uint16_t toneTicks(int dur, int dot, int beat, int bpm)
+{
+	uint32_t ms;
+
+	if(dur <= 0 || bpm <= 0) return 0;
+	ms = (60000u*beat*(dot ? 3 : 2)) / (bpm*dur*2);
+	return ms > 0xFFFF ? 0xFFFF : ms;
+}
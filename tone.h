@@ -0,0 +1,32 @@
+/*
+ *	@author		abradbury
+ */
+
+#ifndef __TONE_H
+#define __TONE_H
+
+#include "stdint.h"
+
+#define TONE_CACHE		4		// The number of compiled ringtones kept
+#define TONE_NAME		32		// Size of a ringtone's name, with the '\0'
+
+typedef struct {
+	uint16_t	note;			// The note number (see toneNote()), 0 for a pause
+	uint16_t	ticks;			// The length of the note in milliseconds
+} NOTE_EVENT;
+
+typedef struct {
+	uint32_t	hash;			// Hash of the RTTTL text or note stream compiled
+	uint32_t	used;			// When the ringtone was last used, 0 if the entry is free
+	int			count;			// The number of events
+	NOTE_EVENT	*events;		// The notes, on the MSYS heap
+	char		name[TONE_NAME];
+} TONE_Type;
+
+uint32_t toneHash(const uint8_t *data, int len);
+TONE_Type* toneFind(uint32_t hash);
+TONE_Type* toneNew(uint32_t hash, int count);
+void toneDrop(TONE_Type *tone);
+int toneNote(int pitch, int octave);
+uint16_t toneTicks(int dur, int dot, int beat, int bpm);
+#endif
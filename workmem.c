@@ -0,0 +1,81 @@
+/*	
+ *	@author		abradbury
+ *	
+ *	Workmem.c shares one region of working memory between the parts of the 
+ *	program that need a large buffer for a short time: morse playback and 
+ *	showing a message on the LCD. These never run at the same time, so rather 
+ *	than each keeping its own static arrays they borrow the region in turn. 
+ *	Ringtones used to borrow it too, but are now parsed as they are read (see 
+ *	rtttl.c) and need no buffer.
+ *	
+ *	The region is the top of the decode arena, above the received message 
+ *	being handled. workTake() records the owner and the arena position, the 
+ *	owner then allocates what it needs with arenaAlloc(), and workGive() 
+ *	releases it all. Taking the region while another part owns it, or giving 
+ *	back a region that is not owned, is a bug and is reported on the terminal.
+ */
+
+#include "serial.h"
+#include "string.h"
+#include "arena.h"
+#include "workmem.h"
+
+int				workOwned = WORK_NONE;	// The part of the program using the region
+uint32_t		workMark = 0;			// The decode arena position when it was taken
+
+const char		*workNames[3] = {"none", "morse", "display"};
+
+/*	
+ *	workReport() prints an ownership error to the terminal.
+ */
+static void workReport(char msg[], int owner)
+{
+	write_usb_serial_blocking(msg, strlen(msg));
+	write_usb_serial_blocking((char*)workNames[owner], strlen(workNames[owner]));
+	write_usb_serial_blocking("\n\r",2);
+}
+
+/*	
+ *	workTake() gives the working memory to part of the program.
+ *	
+ *	@param	owner		The part taking the memory, one of the WORK_ values
+ *	@return				1 if the memory was taken, 0 if it is in use
+ */
+int workTake(int owner)
+{
+	if(workOwned != WORK_NONE)
+	{
+		workReport("Error! Working memory in use by ", workOwned);
+		return 0;
+	}
+	workOwned = owner;
+	workMark = arenaMark(&decodeArena);
+	return 1;
+}
+
+/*	
+ *	workGive() gives the working memory back, releasing everything the owner 
+ *	allocated while it held it.
+ *	
+ *	@param	owner		The part giving the memory back
+ */
+void workGive(int owner)
+{
+	if(workOwned != owner)
+	{
+		workReport("Error! Working memory not owned by ", owner);
+		return;
+	}
+	arenaReset(&decodeArena, workMark);
+	workOwned = WORK_NONE;
+}
+
+/*	
+ *	workOwner() returns the part of the program using the working memory.
+ *	
+ *	@return				One of the WORK_ values
+ */
+int workOwner()
+{
+	return workOwned;
+}
@@ -0,0 +1,15 @@
+/*	
+ *	@author		abradbury
+ */
+
+#ifndef __WORKMEM_H
+#define __WORKMEM_H
+
+#define WORK_NONE		0		// The working memory is free
+#define WORK_MORSE		1		// Playing a message as morse code
+#define WORK_DISPLAY	2		// Showing a message on the LCD
+
+int workTake(int owner);
+void workGive(int owner);
+int workOwner();
+#endif